@@ -0,0 +1,99 @@
+/*
+    SPDX-FileCopyrightText: 2025 Dennis Lübke <kde@dennis2society.de>
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "gpgmeppwrapper.hpp"
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+/// local functions
+
+// The start of a public-key encrypted session key packet (new format,
+// tag 1, version 3), enough for GPGMeWrapper::hasEncryptedPacketHeader()
+QByteArray encryptedPackets()
+{
+    QByteArray packets("\xc1\x0c\x03", 3);
+    for (char c = 0; c < 11; ++c) {
+        packets.append(c);
+    }
+    return packets;
+}
+
+// CRC-24 of RFC 4880 section 6.1
+quint32 crc24(const QByteArray &data_)
+{
+    quint32 crc = 0xB704CE;
+    for (const char c : data_) {
+        crc ^= static_cast<quint32>(static_cast<uchar>(c)) << 16;
+        for (int i = 0; i < 8; ++i) {
+            crc <<= 1;
+            if (crc & 0x1000000) {
+                crc ^= 0x1864CFB;
+            }
+        }
+    }
+    return crc & 0xFFFFFF;
+}
+
+// armors packets_ like gpg --armor does
+QByteArray armor(const QByteArray &packets_)
+{
+    const quint32 crc = crc24(packets_);
+    const char checksum[3] = {char(crc >> 16), char(crc >> 8), char(crc)};
+    return "-----BEGIN PGP MESSAGE-----\n\n" + packets_.toBase64() + "\n=" + QByteArray(checksum, 3).toBase64() + "\n-----END PGP MESSAGE-----\n";
+}
+
+/// class functions
+
+class DearmorFileTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void dearmorFile_data();
+    void dearmorFile();
+};
+
+void DearmorFileTest::dearmorFile_data()
+{
+    QTest::addColumn<QByteArray>("before");
+    QTest::addColumn<QByteArray>("after");
+    QTest::addColumn<bool>("converted");
+
+    QTest::newRow("message only") << QByteArray() << QByteArray() << true;
+    QTest::newRow("surrounding whitespace") << QByteArray("\n \t\n") << QByteArray("\n\n  \n") << true;
+    QTest::newRow("text after the message") << QByteArray() << QByteArray("my notes\n") << false;
+    QTest::newRow("second message") << QByteArray() << armor(encryptedPackets()) << false;
+    QTest::newRow("text before the message") << QByteArray("my notes\n") << QByteArray() << false;
+}
+
+void DearmorFileTest::dearmorFile()
+{
+    QFETCH(QByteArray, before);
+    QFETCH(QByteArray, after);
+    QFETCH(bool, converted);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath(QStringLiteral("document.gpg"));
+    const QByteArray content = before + armor(encryptedPackets()) + after;
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QCOMPARE(file.write(content), content.size());
+    file.close();
+
+    QString errorMessage;
+    QCOMPARE(GPGMeWrapper::dearmorFile(path, errorMessage), converted);
+    QCOMPARE(errorMessage.isEmpty(), converted);
+
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    // a refused file must be left exactly as it was
+    QCOMPARE(file.readAll(), converted ? encryptedPackets() : content);
+}
+
+QTEST_GUILESS_MAIN(DearmorFileTest)
+
+#include "dearmorfiletest.moc"
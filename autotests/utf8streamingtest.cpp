@@ -0,0 +1,307 @@
+/*
+    SPDX-FileCopyrightText: 2025 Dennis Lübke <kde@dennis2society.de>
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+/**
+ * @brief Multibyte text through the streaming data providers and the
+ * en-/decryption paths built on them. The readers hand GpgME UTF-8 in
+ * slices and the writer decodes GpgME's output write by write, so
+ * characters whose bytes straddle either boundary must survive intact.
+ */
+
+#include "gpgdataproviders.hpp"
+#include "gpgmeppwrapper.hpp"
+
+#include <KTextEditor/Document>
+#include <KTextEditor/Editor>
+#include <QProcess>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <cstdio>
+#include <memory>
+
+/// local functions
+
+// 2, 3 and 4 byte UTF-8 sequences, a ZWJ emoji sequence and decomposed
+// combining marks (which must come back unnormalized)
+QString mixedText()
+{
+    return QStringLiteral(u"Gr\u00fc\u00dfe, \u4f60\u597d\u4e16\u754c, \u3053\u3093\u306b\u3061\u306f, \U0001F510, "
+                          u"\U0001F469\u200D\U0001F4BB, e\u0301 a\u0308 n\u0303, \u0395\u03bb\u03bb\u03b7\u03bd\u03b9\u03ba\u03ac\n");
+}
+
+// The number of UTF-16 code units StringReader converts per slice
+constexpr qsizetype SliceSize = StreamChunkSize / 3;
+
+// Reads all of reader_ in reads of bufSize_ bytes like GpgME does
+QByteArray readAll(GpgME::DataProvider &reader_, size_t bufSize_)
+{
+    QByteArray result;
+    QByteArray buffer(qsizetype(bufSize_), Qt::Uninitialized);
+    for (;;) {
+        const ssize_t n = reader_.read(buffer.data(), bufSize_);
+        if (n <= 0) {
+            break;
+        }
+        result.append(buffer.constData(), qsizetype(n));
+    }
+    return result;
+}
+
+/// class functions
+
+class Utf8StreamingTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void writerSplitSequences_data();
+    void writerSplitSequences();
+    void writerByteByByte();
+    void writerIncompleteEnd();
+
+    void stringReader_data();
+    void stringReader();
+    void stringReaderRewind();
+    void documentReader();
+
+    void roundTrip_data();
+    void roundTrip();
+
+private:
+    // rows with the column text, straddling the reader and writer boundaries
+    void addTextRows();
+
+    std::unique_ptr<QTemporaryDir> m_gnupgHome;
+    QByteArray m_originalGnupgHome;
+    QString m_fingerprint;
+};
+
+void Utf8StreamingTest::initTestCase()
+{
+    m_originalGnupgHome = qgetenv("GNUPGHOME");
+    const QString gpgPath = QStandardPaths::findExecutable(QStringLiteral("gpg"));
+    if (gpgPath.isEmpty()) {
+        // the provider tests don't need gpg, roundTrip() skips itself
+        return;
+    }
+    m_gnupgHome = std::make_unique<QTemporaryDir>();
+    QVERIFY(m_gnupgHome->isValid());
+    const QString home = m_gnupgHome->path();
+    QFile::setPermissions(home, QFileDevice::ReadOwner | QFileDevice::WriteOwner | QFileDevice::ExeOwner);
+
+    QProcess gpg;
+    QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+    env.insert(QStringLiteral("GNUPGHOME"), home);
+    gpg.setProcessEnvironment(env);
+    gpg.start(gpgPath, {QStringLiteral("--batch"), QStringLiteral("--gen-key")});
+    QVERIFY(gpg.waitForStarted());
+    gpg.write(
+        "%no-protection\n"
+        "Key-Type: EDDSA\n"
+        "Key-Curve: ed25519\n"
+        "Key-Usage: sign\n"
+        "Subkey-Type: ECDH\n"
+        "Subkey-Curve: cv25519\n"
+        "Subkey-Usage: encrypt\n"
+        "Name-Real: Test User\n"
+        "Name-Email: test@example.org\n"
+        "Expire-Date: 0\n"
+        "%commit\n");
+    gpg.closeWriteChannel();
+    QVERIFY(gpg.waitForFinished(-1));
+    QVERIFY2(gpg.exitCode() == 0, gpg.readAllStandardError().constData());
+
+    qputenv("GNUPGHOME", QFile::encodeName(home));
+    GPGMeWrapper wrapper;
+    wrapper.loadKeys(false, false, QString());
+    m_fingerprint = wrapper.defaultSecretKeyFingerprint();
+    QVERIFY(!m_fingerprint.isEmpty());
+}
+
+void Utf8StreamingTest::cleanupTestCase()
+{
+    const QString gpgconf = QStandardPaths::findExecutable(QStringLiteral("gpgconf"));
+    if (m_gnupgHome && !gpgconf.isEmpty()) {
+        QProcess::execute(gpgconf, {QStringLiteral("--kill"), QStringLiteral("all")});
+    }
+    if (m_originalGnupgHome.isNull()) {
+        qunsetenv("GNUPGHOME");
+    } else {
+        qputenv("GNUPGHOME", m_originalGnupgHome);
+    }
+}
+
+void Utf8StreamingTest::writerSplitSequences_data()
+{
+    QTest::addColumn<QString>("text");
+
+    QTest::newRow("2 byte") << QStringLiteral(u"\u00fc");
+    QTest::newRow("3 byte") << QStringLiteral(u"\u4f60");
+    QTest::newRow("4 byte") << QStringLiteral(u"\U0001F510");
+    QTest::newRow("combining mark") << QStringLiteral(u"e\u0301");
+    QTest::newRow("mixed") << mixedText();
+}
+
+// every way of splitting the output into two writes
+void Utf8StreamingTest::writerSplitSequences()
+{
+    QFETCH(QString, text);
+    const QByteArray utf8 = text.toUtf8();
+
+    for (qsizetype split = 0; split <= utf8.size(); ++split) {
+        QString decoded;
+        Utf8StringWriter writer(decoded);
+        QCOMPARE(writer.write(utf8.constData(), size_t(split)), ssize_t(split));
+        QCOMPARE(writer.write(utf8.constData() + split, size_t(utf8.size() - split)), ssize_t(utf8.size() - split));
+        // nothing may be left for finish() to decode
+        QCOMPARE(decoded, text);
+        writer.finish();
+        QCOMPARE(decoded, text);
+        QCOMPARE(writer.bytesWritten(), qint64(utf8.size()));
+    }
+}
+
+void Utf8StreamingTest::writerByteByByte()
+{
+    const QString text = mixedText();
+    const QByteArray utf8 = text.toUtf8();
+
+    QString decoded;
+    Utf8StringWriter writer(decoded);
+    for (const char c : utf8) {
+        QCOMPARE(writer.write(&c, 1), ssize_t(1));
+        // a character only shows up once all of its bytes are written
+        QVERIFY(!decoded.contains(QChar::ReplacementCharacter));
+    }
+    writer.finish();
+    QCOMPARE(decoded, text);
+}
+
+void Utf8StreamingTest::writerIncompleteEnd()
+{
+    // the first 2 bytes of the 4 byte U+1F510
+    const QByteArray truncated = QByteArrayLiteral("abc\xf0\x9f");
+
+    QString decoded;
+    Utf8StringWriter writer(decoded);
+    writer.write(truncated.constData(), size_t(truncated.size()));
+    QCOMPARE(decoded, QStringLiteral("abc"));
+    writer.finish();
+    QVERIFY(decoded.startsWith(QStringLiteral("abc")));
+    QVERIFY(decoded.mid(3).contains(QChar::ReplacementCharacter));
+}
+
+void Utf8StreamingTest::addTextRows()
+{
+    QTest::addColumn<QString>("text");
+
+    const QString ascii(SliceSize - 1, QLatin1Char('a'));
+    QTest::newRow("mixed") << mixedText();
+    // the high surrogate is the last code unit of the first slice
+    QTest::newRow("surrogate pair across slice") << ascii + QStringLiteral(u"\U0001F510 after");
+    // the second slice starts with a combining mark
+    QTest::newRow("combining mark across slice") << ascii + QStringLiteral(u"e\u0301 after");
+    // a slice of 3 byte sequences, reads of power of two sizes end inside one
+    QTest::newRow("CJK across slice") << QString(SliceSize, QChar(0x4f60)) + QStringLiteral(u"\u597d\u4e16\u754c");
+    // several chunks; 2, 3 and 4 byte sequences at every offset modulo the
+    // power of two sizes GpgME reads and writes in
+    QString mixed;
+    while (mixed.size() < 4 * StreamChunkSize) {
+        mixed += mixedText();
+    }
+    QTest::newRow("many chunks") << mixed;
+}
+
+void Utf8StreamingTest::stringReader_data()
+{
+    addTextRows();
+}
+
+void Utf8StreamingTest::stringReader()
+{
+    QFETCH(QString, text);
+    const QByteArray expected = text.toUtf8();
+    // the progress total of encryptString()
+    QCOMPARE(utf8Length(text), qint64(expected.size()));
+
+    for (const size_t bufSize : {size_t(1), size_t(7), size_t(4096), size_t(StreamChunkSize)}) {
+        StringReader reader(text);
+        const QByteArray utf8 = readAll(reader, bufSize);
+        QCOMPARE(utf8.size(), expected.size());
+        QVERIFY2(utf8 == expected, qPrintable(QStringLiteral("read buffer of %1 bytes").arg(bufSize)));
+        QCOMPARE(reader.bytesRead(), qint64(expected.size()));
+    }
+}
+
+// GpgME rewinds the input after sniffing its type
+void Utf8StreamingTest::stringReaderRewind()
+{
+    const QString text = QString(SliceSize - 1, QLatin1Char('a')) + QStringLiteral(u"\U0001F510") + mixedText();
+    const QByteArray expected = text.toUtf8();
+
+    StringReader reader(text);
+    QByteArray buffer(4096, Qt::Uninitialized);
+    QVERIFY(reader.read(buffer.data(), size_t(buffer.size())) > 0);
+    QCOMPARE(reader.seek(0, SEEK_SET), off_t(0));
+    QCOMPARE(readAll(reader, 4096), expected);
+}
+
+void Utf8StreamingTest::documentReader()
+{
+    QString text;
+    while (text.size() < 2 * StreamChunkSize) {
+        text += mixedText();
+    }
+    text += QStringLiteral(u"no newline at the end: \U0001F510");
+
+    std::unique_ptr<KTextEditor::Document> doc(KTextEditor::Editor::instance()->createDocument(nullptr));
+    QVERIFY(doc->setText(text));
+
+    for (const size_t bufSize : {size_t(1), size_t(4096)}) {
+        DocumentReader reader(doc.get());
+        QCOMPARE(readAll(reader, bufSize), doc->text().toUtf8());
+    }
+}
+
+void Utf8StreamingTest::roundTrip_data()
+{
+    addTextRows();
+}
+
+void Utf8StreamingTest::roundTrip()
+{
+    if (m_fingerprint.isEmpty()) {
+        QSKIP("gpg not found in PATH");
+    }
+    QFETCH(QString, text);
+    GPGMeWrapper wrapper;
+    wrapper.loadKeys(false, false, QString());
+
+    const GPGOperationResult encrypted = wrapper.encryptString(text, {m_fingerprint}, QStringLiteral("test@example.org"), true);
+    QVERIFY2(encrypted.decryptionSuccess, qPrintable(encrypted.errorMessage));
+    const GPGOperationResult decrypted = wrapper.decryptString(encrypted.resultString, m_fingerprint);
+    QVERIFY2(decrypted.decryptionSuccess, qPrintable(decrypted.errorMessage));
+    QCOMPARE(decrypted.resultString, text);
+
+    // the document paths, the text is read line by line
+    std::unique_ptr<KTextEditor::Document> doc(KTextEditor::Editor::instance()->createDocument(nullptr));
+    QVERIFY(doc->setText(text));
+    const QString documentText = doc->text();
+    const GPGOperationResult docEncrypted = wrapper.encryptDocument(doc.get(), {m_fingerprint}, QStringLiteral("test@example.org"), true);
+    QVERIFY2(docEncrypted.decryptionSuccess, qPrintable(docEncrypted.errorMessage));
+    QVERIFY(doc->setText(docEncrypted.resultString));
+    const GPGOperationResult docDecrypted = wrapper.decryptDocument(doc.get(), m_fingerprint);
+    QVERIFY2(docDecrypted.decryptionSuccess, qPrintable(docDecrypted.errorMessage));
+    QCOMPARE(docDecrypted.resultString, documentText);
+}
+
+QTEST_MAIN(Utf8StreamingTest)
+
+#include "utf8streamingtest.moc"
@@ -0,0 +1,336 @@
+/*
+    SPDX-FileCopyrightText: 2025 Dennis Lübke <kde@dennis2society.de>
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+/**
+ * @brief Benchmarks of the GPGMeWrapper paths hit on every open/save,
+ * run against throwaway GPG home dirs with synthetic keys, so the real
+ * keyring is never touched.
+ *
+ * By default keyrings of 10, 100 and 1000 keys and payloads of 1 KB,
+ * 1 MB and 10 MB are measured. Set KATE_GPG_BENCHMARK_FULL=1 to add
+ * 10000 keys and 100/500 MB payloads (this needs a few GB of memory and
+ * QTEST_FUNCTION_TIMEOUT raised for generating the large keyring).
+ */
+
+#include "gpgmeppwrapper.hpp"
+
+#include <QProcess>
+#include <QRandomGenerator>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <map>
+#include <memory>
+
+/// local functions
+
+QVector<int> keyringSizes()
+{
+    QVector<int> sizes = {10, 100, 1000};
+    if (qEnvironmentVariableIsSet("KATE_GPG_BENCHMARK_FULL")) {
+        sizes.append(10000);
+    }
+    return sizes;
+}
+
+QVector<qsizetype> payloadSizes()
+{
+    QVector<qsizetype> sizes = {1024, 1024 * 1024, 10 * 1024 * 1024};
+    if (qEnvironmentVariableIsSet("KATE_GPG_BENCHMARK_FULL")) {
+        sizes.append(100 * 1024 * 1024);
+        sizes.append(500 * 1024 * 1024);
+    }
+    return sizes;
+}
+
+QString payloadName(qsizetype size_)
+{
+    if (size_ >= 1024 * 1024) {
+        return QStringLiteral("%1 MB").arg(size_ / (1024 * 1024));
+    }
+    return QStringLiteral("%1 KB").arg(size_ / 1024);
+}
+
+// base64 like text in lines of 76 characters, what users usually store
+QString makePayload(qsizetype size_)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    QRandomGenerator generator(42);
+    QString payload(size_, Qt::Uninitialized);
+    QChar *out = payload.data();
+    for (qsizetype i = 0; i < size_; ++i) {
+        out[i] = (i % 77 == 76) ? QLatin1Char('\n') : QLatin1Char(alphabet[generator.bounded(64)]);
+    }
+    return payload;
+}
+
+// gpg --gen-key parameters of numKeys_ unprotected ed25519/cv25519 keys
+QByteArray keyGenerationParameters(int firstKey_, int numKeys_)
+{
+    QByteArray parameters;
+    for (int i = firstKey_; i < firstKey_ + numKeys_; ++i) {
+        parameters += "%no-protection\n"
+                      "Key-Type: EDDSA\n"
+                      "Key-Curve: ed25519\n"
+                      "Key-Usage: sign\n"
+                      "Subkey-Type: ECDH\n"
+                      "Subkey-Curve: cv25519\n"
+                      "Subkey-Usage: encrypt\n"
+                      "Name-Real: Bench User "
+            + QByteArray::number(i)
+            + "\n"
+              "Name-Email: bench"
+            + QByteArray::number(i)
+            + "@example.org\n"
+              "Expire-Date: 0\n"
+              "%commit\n";
+    }
+    return parameters;
+}
+
+/// class functions
+
+class GPGMeWrapperBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void loadKeys_data();
+    void loadKeys();
+    void encryptString_data();
+    void encryptString();
+    void decryptString_data();
+    void decryptString();
+    void isEncrypted_data();
+    void isEncrypted();
+
+private:
+    // A GPG home dir with a fixed number of keys
+    struct Keyring {
+        std::unique_ptr<QTemporaryDir> homeDir;
+        QString fingerprint; // key used for en-/decryption
+    };
+
+    // Generates the keyring with numKeys_ keys on first use
+    Keyring *keyring(int numKeys_);
+
+    /**
+     * @brief Switches gpg to the keyring with numKeys_ keys and returns a
+     *        wrapper with its keys loaded. gpg is started per operation
+     *        and reads GNUPGHOME each time, so the keyrings can be
+     *        switched within one process.
+     */
+    std::unique_ptr<GPGMeWrapper> wrapperFor(int numKeys_);
+
+    // rows "<keys> keys/<payload>" with the columns numKeys and payloadSize
+    void addKeyringAndPayloadRows();
+
+    QString m_gpgPath;
+    std::map<int, Keyring> m_keyrings;
+    QByteArray m_originalGnupgHome;
+};
+
+void GPGMeWrapperBenchmark::initTestCase()
+{
+    m_gpgPath = QStandardPaths::findExecutable(QStringLiteral("gpg"));
+    if (m_gpgPath.isEmpty()) {
+        QSKIP("gpg not found in PATH");
+    }
+    m_originalGnupgHome = qgetenv("GNUPGHOME");
+}
+
+void GPGMeWrapperBenchmark::cleanupTestCase()
+{
+    const QString gpgconf = QStandardPaths::findExecutable(QStringLiteral("gpgconf"));
+    for (const auto &entry : m_keyrings) {
+        if (!gpgconf.isEmpty()) {
+            QProcess process;
+            QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+            env.insert(QStringLiteral("GNUPGHOME"), entry.second.homeDir->path());
+            process.setProcessEnvironment(env);
+            process.start(gpgconf, {QStringLiteral("--kill"), QStringLiteral("all")});
+            process.waitForFinished();
+        }
+    }
+    m_keyrings.clear();
+    if (m_originalGnupgHome.isNull()) {
+        qunsetenv("GNUPGHOME");
+    } else {
+        qputenv("GNUPGHOME", m_originalGnupgHome);
+    }
+}
+
+GPGMeWrapperBenchmark::Keyring *GPGMeWrapperBenchmark::keyring(int numKeys_)
+{
+    const auto it = m_keyrings.find(numKeys_);
+    if (it != m_keyrings.end()) {
+        return &it->second;
+    }
+    Keyring keyring;
+    keyring.homeDir = std::make_unique<QTemporaryDir>();
+    if (!keyring.homeDir->isValid()) {
+        return nullptr;
+    }
+    const QString home = keyring.homeDir->path();
+    QFile::setPermissions(home, QFileDevice::ReadOwner | QFileDevice::WriteOwner | QFileDevice::ExeOwner);
+    QFile agentConf(home + QStringLiteral("/gpg-agent.conf"));
+    if (!agentConf.open(QIODevice::WriteOnly) || agentConf.write("allow-loopback-pinentry\n") < 0) {
+        return nullptr;
+    }
+    agentConf.close();
+
+    // one gpg process generates all keys, much faster than --quick-gen-key per key
+    qInfo() << "generating" << numKeys_ << "keys in" << home;
+    QProcess gpg;
+    QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+    env.insert(QStringLiteral("GNUPGHOME"), home);
+    gpg.setProcessEnvironment(env);
+    gpg.start(m_gpgPath, {QStringLiteral("--batch"), QStringLiteral("--pinentry-mode"), QStringLiteral("loopback"), QStringLiteral("--gen-key")});
+    if (!gpg.waitForStarted()) {
+        return nullptr;
+    }
+    gpg.write(keyGenerationParameters(1, numKeys_));
+    gpg.closeWriteChannel();
+    if (!gpg.waitForFinished(-1) || gpg.exitCode() != 0) {
+        qWarning() << gpg.readAllStandardError();
+        return nullptr;
+    }
+    return &m_keyrings.emplace(numKeys_, std::move(keyring)).first->second;
+}
+
+std::unique_ptr<GPGMeWrapper> GPGMeWrapperBenchmark::wrapperFor(int numKeys_)
+{
+    Keyring *ring = keyring(numKeys_);
+    if (!ring) {
+        return nullptr;
+    }
+    qputenv("GNUPGHOME", QFile::encodeName(ring->homeDir->path()));
+    auto wrapper = std::make_unique<GPGMeWrapper>();
+    wrapper->loadKeys(false, false, QString());
+    if (ring->fingerprint.isEmpty()) {
+        ring->fingerprint = wrapper->defaultSecretKeyFingerprint();
+    }
+    return wrapper;
+}
+
+void GPGMeWrapperBenchmark::addKeyringAndPayloadRows()
+{
+    QTest::addColumn<int>("numKeys");
+    QTest::addColumn<qsizetype>("payloadSize");
+    for (const int numKeys : keyringSizes()) {
+        for (const qsizetype payloadSize : payloadSizes()) {
+            QTest::addRow("%d keys/%s", numKeys, qPrintable(payloadName(payloadSize))) << numKeys << payloadSize;
+        }
+    }
+}
+
+void GPGMeWrapperBenchmark::loadKeys_data()
+{
+    QTest::addColumn<int>("numKeys");
+    QTest::addColumn<bool>("cached");
+    for (const int numKeys : keyringSizes()) {
+        QTest::addRow("%d keys/gpg", numKeys) << numKeys << false;
+        QTest::addRow("%d keys/cached", numKeys) << numKeys << true;
+    }
+}
+
+void GPGMeWrapperBenchmark::loadKeys()
+{
+    QFETCH(int, numKeys);
+    QFETCH(bool, cached);
+    std::unique_ptr<GPGMeWrapper> wrapper = wrapperFor(numKeys);
+    QVERIFY(wrapper);
+    QCOMPARE(int(wrapper->getNumKeys()), numKeys);
+    // gpg: a full key listing, as at startup and after a keyring change
+    // cached: filtering the in-memory keyring, as for every search
+    QBENCHMARK {
+        if (!cached) {
+            wrapper->invalidateKeyCache();
+        }
+        wrapper->loadKeys(false, false, QString());
+    }
+    QCOMPARE(int(wrapper->getNumKeys()), numKeys);
+}
+
+void GPGMeWrapperBenchmark::encryptString_data()
+{
+    addKeyringAndPayloadRows();
+}
+
+void GPGMeWrapperBenchmark::encryptString()
+{
+    QFETCH(int, numKeys);
+    QFETCH(qsizetype, payloadSize);
+    std::unique_ptr<GPGMeWrapper> wrapper = wrapperFor(numKeys);
+    QVERIFY(wrapper);
+    const QString fingerprint = keyring(numKeys)->fingerprint;
+    QVERIFY(!fingerprint.isEmpty());
+    const QString payload = makePayload(payloadSize);
+    GPGOperationResult result;
+    QBENCHMARK {
+        result = wrapper->encryptString(payload, {fingerprint}, QString(), true, false, false);
+    }
+    QVERIFY2(result.errorMessage.isEmpty(), qPrintable(result.errorMessage));
+}
+
+void GPGMeWrapperBenchmark::decryptString_data()
+{
+    addKeyringAndPayloadRows();
+}
+
+void GPGMeWrapperBenchmark::decryptString()
+{
+    QFETCH(int, numKeys);
+    QFETCH(qsizetype, payloadSize);
+    std::unique_ptr<GPGMeWrapper> wrapper = wrapperFor(numKeys);
+    QVERIFY(wrapper);
+    const QString fingerprint = keyring(numKeys)->fingerprint;
+    QString ciphertext = wrapper->encryptString(makePayload(payloadSize), {fingerprint}, QString(), true, false, false).resultString;
+    QVERIFY(!ciphertext.isEmpty());
+    GPGOperationResult result;
+    QBENCHMARK {
+        result = wrapper->decryptString(ciphertext, fingerprint);
+    }
+    QVERIFY2(result.decryptionSuccess, qPrintable(result.errorMessage));
+    QCOMPARE(qsizetype(result.resultString.size()), payloadSize);
+}
+
+void GPGMeWrapperBenchmark::isEncrypted_data()
+{
+    QTest::addColumn<int>("numKeys");
+    QTest::addColumn<qsizetype>("payloadSize");
+    QTest::addColumn<bool>("strictCheck");
+    for (const int numKeys : keyringSizes()) {
+        for (const qsizetype payloadSize : payloadSizes()) {
+            QTest::addRow("%d keys/%s/header", numKeys, qPrintable(payloadName(payloadSize))) << numKeys << payloadSize << false;
+            QTest::addRow("%d keys/%s/strict", numKeys, qPrintable(payloadName(payloadSize))) << numKeys << payloadSize << true;
+        }
+    }
+}
+
+void GPGMeWrapperBenchmark::isEncrypted()
+{
+    QFETCH(int, numKeys);
+    QFETCH(qsizetype, payloadSize);
+    QFETCH(bool, strictCheck);
+    std::unique_ptr<GPGMeWrapper> wrapper = wrapperFor(numKeys);
+    QVERIFY(wrapper);
+    const QString fingerprint = keyring(numKeys)->fingerprint;
+    const QString ciphertext = wrapper->encryptString(makePayload(payloadSize), {fingerprint}, QString(), true, false, false).resultString;
+    QVERIFY(!ciphertext.isEmpty());
+    bool encrypted = false;
+    QBENCHMARK {
+        encrypted = wrapper->isEncrypted(ciphertext, strictCheck);
+    }
+    QVERIFY(encrypted);
+}
+
+QTEST_GUILESS_MAIN(GPGMeWrapperBenchmark)
+
+#include "gpgmeppwrapperbenchmark.moc"
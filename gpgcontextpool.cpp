@@ -0,0 +1,76 @@
+/*
+    SPDX-FileCopyrightText: 2025 Dennis Lübke <kde@dennis2society.de>
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <gpgme++/global.h>
+
+#include "gpgcontextpool.hpp"
+
+#include <QMutexLocker>
+
+#include <mutex>
+
+void GPGContextPool::ContextReturner::operator()(GpgME::Context *ctx_) const
+{
+    if (!ctx_) {
+        return;
+    }
+    if (pool && reuse) {
+        pool->release(ctx_, armor, textMode);
+    } else {
+        delete ctx_;
+    }
+}
+
+GPGContextPool::GPGContextPool(size_t maxIdlePerVariant_)
+    : m_maxIdlePerVariant(maxIdlePerVariant_)
+{
+    // initializing GpgME is only needed once per process
+    static std::once_flag initialized;
+    std::call_once(initialized, []() {
+        GpgME::initializeLibrary();
+    });
+}
+
+GPGContextPool::~GPGContextPool() = default;
+
+size_t GPGContextPool::variantIndex(bool armor_, bool textMode_)
+{
+    return (armor_ ? 2 : 0) + (textMode_ ? 1 : 0);
+}
+
+GPGContextPool::ContextHandle GPGContextPool::acquire(bool armor_, bool textMode_)
+{
+    ContextHandle handle(nullptr, ContextReturner{this, armor_, textMode_, true});
+    {
+        QMutexLocker locker(&m_mutex);
+        auto &idle = m_idleContexts[variantIndex(armor_, textMode_)];
+        if (!idle.empty()) {
+            handle.reset(idle.back().release());
+            idle.pop_back();
+            return handle;
+        }
+    }
+    GpgME::Context *ctx = GpgME::Context::createForProtocol(GpgME::OpenPGP);
+    if (!ctx) {
+        return handle;
+    }
+    ctx->setArmor(armor_);
+    ctx->setTextMode(textMode_);
+    handle.reset(ctx);
+    return handle;
+}
+
+void GPGContextPool::release(GpgME::Context *ctx_, bool armor_, bool textMode_)
+{
+    // undo per-operation settings, armor and text mode stay as they are
+    ctx_->setProgressProvider(nullptr);
+    ctx_->setKeyListMode(GpgME::Local);
+    std::unique_ptr<GpgME::Context> ctx(ctx_);
+    QMutexLocker locker(&m_mutex);
+    auto &idle = m_idleContexts[variantIndex(armor_, textMode_)];
+    if (idle.size() < m_maxIdlePerVariant) {
+        idle.push_back(std::move(ctx));
+    }
+}
@@ -0,0 +1,65 @@
+/*
+    SPDX-FileCopyrightText: 2025 Dennis Lübke <kde@dennis2society.de>
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#pragma once
+
+/**
+ * @brief A small pool of preconfigured OpenPGP contexts.
+ * Operations borrow a context for the duration of one GpgME call and
+ * hand it back afterwards, so the library initialization and context
+ * setup is not repeated for every save.
+ * Borrowing and returning is thread-safe, a borrowed context must only
+ * be used by one thread at a time.
+ */
+
+#include <gpgme++/context.h>
+
+#include <QMutex>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+class GPGContextPool
+{
+public:
+    /**
+     * @brief Deleter of ContextHandle: returns the context to the pool.
+     *        Set reuse to false for contexts that must not be reused
+     *        (e.g. after a cancelled operation).
+     */
+    struct ContextReturner {
+        GPGContextPool *pool = nullptr;
+        bool armor = false;
+        bool textMode = false;
+        bool reuse = true;
+        void operator()(GpgME::Context *ctx_) const;
+    };
+    using ContextHandle = std::unique_ptr<GpgME::Context, ContextReturner>;
+
+    /**
+     * @param maxIdlePerVariant_ Number of idle contexts kept per
+     *        armor/textmode combination, surplus contexts get deleted.
+     */
+    explicit GPGContextPool(size_t maxIdlePerVariant_ = 4);
+
+    ~GPGContextPool();
+
+    /**
+     * @brief Borrows an OpenPGP context with the given settings.
+     * @return The context or an empty handle if GpgME failed to create one.
+     */
+    ContextHandle acquire(bool armor_, bool textMode_);
+
+private:
+    void release(GpgME::Context *ctx_, bool armor_, bool textMode_);
+
+    static size_t variantIndex(bool armor_, bool textMode_);
+
+    QMutex m_mutex;
+    // idle contexts per armor/textmode combination
+    std::array<std::vector<std::unique_ptr<GpgME::Context>>, 4> m_idleContexts;
+    const size_t m_maxIdlePerVariant;
+};
@@ -0,0 +1,324 @@
+/*
+    SPDX-FileCopyrightText: 2025 Dennis Lübke <kde@dennis2society.de>
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "gpgdataproviders.hpp"
+#include "gpgmeppwrapper.hpp"
+
+#include <KTextEditor/Document>
+#include <QIODevice>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+/// local functions
+
+/**
+ * @brief Copies a temporary UTF-8 conversion of plaintext into secure
+ *        memory and wipes the temporary right away.
+ */
+void appendAndWipe(SecureByteArray &target_, QByteArray &&utf8_)
+{
+    target_.append(utf8_.constData(), utf8_.size());
+    secureZero(utf8_.data(), utf8_.size());
+}
+
+qint64 utf8Length(QStringView text_)
+{
+    qint64 length = 0;
+    const qsizetype size = text_.size();
+    for (qsizetype i = 0; i < size; ++i) {
+        const char16_t c = text_[i].unicode();
+        if (c < 0x80) {
+            length += 1;
+        } else if (c < 0x800) {
+            length += 2;
+        } else if (QChar::isHighSurrogate(c) && i + 1 < size && text_[i + 1].isLowSurrogate()) {
+            length += 4;
+            ++i;
+        } else {
+            length += 3;
+        }
+    }
+    return length;
+}
+
+/// class functions
+
+ByteProgress::ByteProgress(GPGMeWrapper *wrapper_, qint64 totalBytes_, bool enabled_)
+    : m_wrapper(wrapper_)
+    , m_totalBytes(totalBytes_)
+    , m_enabled(enabled_)
+{
+}
+
+void ByteProgress::add(qint64 bytes_)
+{
+    if (!m_enabled || bytes_ <= 0) {
+        return;
+    }
+    if (!m_timer.isValid()) {
+        m_timer.start();
+    }
+    m_processedBytes += bytes_;
+    const qint64 elapsed = m_timer.elapsed();
+    // the end of the input is reported right away, but only once
+    const bool done = m_totalBytes > 0 && m_processedBytes >= m_totalBytes && !m_doneReported;
+    if (!done && elapsed - m_lastEmitMsecs < 100) {
+        return;
+    }
+    m_doneReported = m_doneReported || done;
+    m_lastEmitMsecs = elapsed;
+    const double bytesPerSecond = elapsed > 0 ? m_processedBytes * 1000.0 / elapsed : 0.0;
+    Q_EMIT m_wrapper->operationThroughput(m_processedBytes, m_totalBytes, bytesPerSecond);
+}
+
+void ByteProgress::restart()
+{
+    m_processedBytes = 0;
+    m_doneReported = false;
+}
+
+Utf8ChunkReader::Utf8ChunkReader()
+    : m_chunk(StreamChunkSize)
+{
+}
+
+ssize_t Utf8ChunkReader::read(void *buffer, size_t bufSize)
+{
+    char *out = static_cast<char *>(buffer);
+    size_t written = 0;
+    while (written < bufSize) {
+        if (m_chunkPos >= m_chunk.size()) {
+            m_chunk.clear();
+            m_chunkPos = 0;
+            QElapsedTimer timer;
+            timer.start();
+            const bool hasMore = nextChunk(m_chunk);
+            m_conversionNsecs += timer.nsecsElapsed();
+            if (!hasMore) {
+                break;
+            }
+            continue;
+        }
+        const size_t n = qMin<size_t>(bufSize - written, m_chunk.size() - m_chunkPos);
+        memcpy(out + written, m_chunk.constData() + m_chunkPos, n);
+        m_chunkPos += n;
+        written += n;
+    }
+    m_position += written;
+    if (m_progress) {
+        m_progress->add(written);
+    }
+    return written;
+}
+
+ssize_t Utf8ChunkReader::write(const void *buffer, size_t bufSize)
+{
+    Q_UNUSED(buffer);
+    Q_UNUSED(bufSize);
+    errno = EBADF;
+    return -1;
+}
+
+off_t Utf8ChunkReader::seek(off_t offset, int whence)
+{
+    // GpgME only ever rewinds or asks for the current position
+    if (offset == 0 && whence == SEEK_CUR) {
+        return m_position;
+    }
+    if (offset == 0 && whence == SEEK_SET) {
+        restart();
+        if (m_progress) {
+            m_progress->restart();
+        }
+        m_chunk.clear();
+        m_chunkPos = 0;
+        m_position = 0;
+        return 0;
+    }
+    errno = EINVAL;
+    return -1;
+}
+
+DocumentReader::DocumentReader(const KTextEditor::Document *doc_)
+    : m_doc(doc_)
+{
+}
+
+bool DocumentReader::nextChunk(SecureByteArray &chunk_)
+{
+    const int numLines = m_doc->lines();
+    if (m_line >= numLines) {
+        return false;
+    }
+    while (m_line < numLines && chunk_.size() < size_t(StreamChunkSize)) {
+        appendAndWipe(chunk_, m_doc->line(m_line).toUtf8());
+        // same as Document::text(): no newline after the last line
+        if (m_line < numLines - 1) {
+            chunk_.append("\n", 1);
+        }
+        ++m_line;
+    }
+    return true;
+}
+
+void DocumentReader::restart()
+{
+    m_line = 0;
+}
+
+StringReader::StringReader(const QString &text_)
+    : m_text(text_)
+{
+}
+
+bool StringReader::nextChunk(SecureByteArray &chunk_)
+{
+    if (m_pos >= m_text.size()) {
+        return false;
+    }
+    // up to 3 bytes per UTF-16 code unit
+    qsizetype length = qMin(StreamChunkSize / 3, m_text.size() - m_pos);
+    if (m_pos + length < m_text.size() && m_text.at(m_pos + length - 1).isHighSurrogate()) {
+        --length; // never split a surrogate pair
+    }
+    appendAndWipe(chunk_, QStringView(m_text).mid(m_pos, length).toUtf8());
+    m_pos += length;
+    return true;
+}
+
+void StringReader::restart()
+{
+    m_pos = 0;
+}
+
+DeviceReader::DeviceReader(QIODevice *device_, ByteProgress &progress_)
+    : m_device(device_)
+    , m_progress(progress_)
+{
+}
+
+ssize_t DeviceReader::read(void *buffer, size_t bufSize)
+{
+    const qint64 n = m_device->read(static_cast<char *>(buffer), qint64(bufSize));
+    if (n < 0) {
+        errno = EIO;
+        return -1;
+    }
+    m_progress.add(n);
+    return n;
+}
+
+ssize_t DeviceReader::write(const void *buffer, size_t bufSize)
+{
+    Q_UNUSED(buffer);
+    Q_UNUSED(bufSize);
+    errno = EBADF;
+    return -1;
+}
+
+off_t DeviceReader::seek(off_t offset, int whence)
+{
+    const qint64 base = whence == SEEK_SET ? 0 : whence == SEEK_CUR ? m_device->pos() : m_device->size();
+    if (base + offset < 0 || !m_device->seek(base + offset)) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (base + offset == 0) {
+        m_progress.restart();
+    }
+    return m_device->pos();
+}
+
+ssize_t SecureMemoryData::read(void *buffer, size_t bufSize)
+{
+    const size_t n = qMin(bufSize, m_data.size() - qMin(m_position, m_data.size()));
+    if (n > 0) {
+        memcpy(buffer, m_data.constData() + m_position, n);
+    }
+    m_position += n;
+    return n;
+}
+
+ssize_t SecureMemoryData::write(const void *buffer, size_t bufSize)
+{
+    if (m_position + bufSize > m_data.size() && !m_data.resize(m_position + bufSize)) {
+        errno = ENOMEM;
+        return -1;
+    }
+    memcpy(m_data.data() + m_position, buffer, bufSize);
+    m_position += bufSize;
+    return bufSize;
+}
+
+off_t SecureMemoryData::seek(off_t offset, int whence)
+{
+    const off_t base = whence == SEEK_SET ? 0 : whence == SEEK_CUR ? off_t(m_position) : off_t(m_data.size());
+    if (base + offset < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    m_position = base + offset;
+    return m_position;
+}
+
+Utf8StringWriter::Utf8StringWriter(QString &target_)
+    : m_target(target_)
+{
+}
+
+ssize_t Utf8StringWriter::read(void *buffer, size_t bufSize)
+{
+    Q_UNUSED(buffer);
+    Q_UNUSED(bufSize);
+    errno = EBADF;
+    return -1;
+}
+
+ssize_t Utf8StringWriter::write(const void *buffer, size_t bufSize)
+{
+    QElapsedTimer timer;
+    timer.start();
+    const char *data = static_cast<const char *>(buffer);
+    m_pending.append(data, bufSize);
+    const size_t complete = completeUtf8Length(m_pending);
+    m_target += QString::fromUtf8(m_pending.constData(), qsizetype(complete));
+    m_pending.remove(complete);
+    m_position += bufSize;
+    m_conversionNsecs += timer.nsecsElapsed();
+    return bufSize;
+}
+
+off_t Utf8StringWriter::seek(off_t offset, int whence)
+{
+    if (offset == 0 && whence == SEEK_CUR) {
+        return m_position;
+    }
+    errno = EINVAL;
+    return -1;
+}
+
+void Utf8StringWriter::finish()
+{
+    if (!m_pending.isEmpty()) {
+        m_target += QString::fromUtf8(m_pending.constData(), qsizetype(m_pending.size()));
+        m_pending.clear();
+    }
+}
+
+size_t Utf8StringWriter::completeUtf8Length(const SecureByteArray &data_)
+{
+    const qsizetype size = qsizetype(data_.size());
+    for (qsizetype i = size - 1; i >= 0 && i >= size - 4; --i) {
+        const uchar c = static_cast<uchar>(data_.constData()[i]);
+        if ((c & 0xc0) == 0x80) {
+            continue; // continuation byte, look further back
+        }
+        const qsizetype sequenceLength = c >= 0xf0 ? 4 : c >= 0xe0 ? 3 : c >= 0xc0 ? 2 : 1;
+        return size_t(i + sequenceLength > size ? i : size);
+    }
+    return size_t(size);
+}
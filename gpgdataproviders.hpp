@@ -0,0 +1,269 @@
+/*
+    SPDX-FileCopyrightText: 2025 Dennis Lübke <kde@dennis2society.de>
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#pragma once
+
+/**
+ * @brief The GpgME::DataProviders GPGMeWrapper streams its input and
+ * output through. They convert between QString and UTF-8 chunk by chunk,
+ * so no operation needs a byte copy of the whole text, and they keep
+ * intermediate plaintext in secure memory (see securememory.hpp).
+ */
+
+#include <gpgme++/interfaces/dataprovider.h>
+
+#include "securememory.hpp"
+
+#include <QElapsedTimer>
+#include <QString>
+
+class GPGMeWrapper;
+class QIODevice;
+
+namespace KTextEditor
+{
+class Document;
+}
+
+// Size of the chunks the text readers hand to GpgME. This bounds the
+// memory used for the UTF-8 representation of the input.
+constexpr qsizetype StreamChunkSize = 64 * 1024;
+
+/**
+ * @brief The size of text_ in UTF-8, without converting it. Used as the
+ *        progress total of the text readers.
+ */
+qint64 utf8Length(QStringView text_);
+
+/**
+ * @brief Counts the input bytes GpgME has consumed and emits them as
+ *        GPGMeWrapper::operationThroughput(). GpgME's own progress
+ *        callback only reports key generation and some packet stages,
+ *        counting the input is the only measure that covers the whole
+ *        operation. Emissions are throttled to keep the queued
+ *        connection to the GUI thread cheap.
+ */
+class ByteProgress
+{
+public:
+    /**
+     * @param totalBytes_ The input size, 0 if unknown.
+     * @param enabled_ Only the operation thread reports progress.
+     */
+    ByteProgress(GPGMeWrapper *wrapper_, qint64 totalBytes_, bool enabled_);
+
+    void add(qint64 bytes_);
+
+    // GpgME rewinds the input, e.g. to sniff its type
+    void restart();
+
+private:
+    GPGMeWrapper *m_wrapper;
+    const qint64 m_totalBytes;
+    const bool m_enabled;
+    qint64 m_processedBytes = 0;
+    qint64 m_lastEmitMsecs = 0;
+    bool m_doneReported = false;
+    QElapsedTimer m_timer;
+};
+
+/**
+ * @brief Base for read-only GpgME::DataProviders that produce UTF-8 encoded
+ *        text chunk by chunk, so the whole text never needs to exist as
+ *        one byte buffer. Subclasses only provide the next chunk.
+ *        The chunk is plaintext, it lives in pooled secure memory.
+ */
+class Utf8ChunkReader : public GpgME::DataProvider
+{
+public:
+    Utf8ChunkReader();
+
+    bool isSupported(Operation op) const override
+    {
+        return op == Read || op == Seek || op == Release;
+    }
+
+    ssize_t read(void *buffer, size_t bufSize) override;
+    ssize_t write(const void *buffer, size_t bufSize) override;
+    off_t seek(off_t offset, int whence) override;
+
+    void release() override
+    {
+    }
+
+    // time spent converting the text to UTF-8
+    qint64 conversionNsecs() const
+    {
+        return m_conversionNsecs;
+    }
+
+    qint64 bytesRead() const
+    {
+        return m_position;
+    }
+
+    // progress_ must outlive the reader
+    void setProgress(ByteProgress *progress_)
+    {
+        m_progress = progress_;
+    }
+
+protected:
+    // Appends the next piece of UTF-8 text to chunk_, returns false at the end
+    virtual bool nextChunk(SecureByteArray &chunk_) = 0;
+    // Starts over from the beginning of the text
+    virtual void restart() = 0;
+
+private:
+    SecureByteArray m_chunk;
+    size_t m_chunkPos = 0;
+    off_t m_position = 0;
+    qint64 m_conversionNsecs = 0;
+    ByteProgress *m_progress = nullptr;
+};
+
+/**
+ * @brief Streams the text of a KTextEditor::Document line by line.
+ *        Must only be used in the thread owning the document.
+ */
+class DocumentReader : public Utf8ChunkReader
+{
+public:
+    explicit DocumentReader(const KTextEditor::Document *doc_);
+
+protected:
+    bool nextChunk(SecureByteArray &chunk_) override;
+    void restart() override;
+
+private:
+    const KTextEditor::Document *m_doc;
+    int m_line = 0;
+};
+
+/**
+ * @brief Streams a QString slice by slice, so there is no UTF-8 copy of
+ *        the whole text.
+ */
+class StringReader : public Utf8ChunkReader
+{
+public:
+    explicit StringReader(const QString &text_);
+
+protected:
+    bool nextChunk(SecureByteArray &chunk_) override;
+    void restart() override;
+
+private:
+    const QString &m_text;
+    qsizetype m_pos = 0;
+};
+
+/**
+ * @brief Read-only GpgME::DataProvider over an open QIODevice (a file or
+ *        a QBuffer) that counts the bytes GpgME reads. Files are opened
+ *        unbuffered, so this reads the file descriptor directly in the
+ *        block size GpgME asks for.
+ */
+class DeviceReader : public GpgME::DataProvider
+{
+public:
+    DeviceReader(QIODevice *device_, ByteProgress &progress_);
+
+    bool isSupported(Operation op) const override
+    {
+        return op == Read || op == Seek || op == Release;
+    }
+
+    ssize_t read(void *buffer, size_t bufSize) override;
+    ssize_t write(const void *buffer, size_t bufSize) override;
+    off_t seek(off_t offset, int whence) override;
+
+    void release() override
+    {
+    }
+
+private:
+    QIODevice *m_device;
+    ByteProgress &m_progress;
+};
+
+/**
+ * @brief Read-write GpgME::DataProvider in pooled secure memory, for
+ *        plaintext that has to be kept as bytes (see
+ *        GPGMeWrapper::reencryptFile()).
+ */
+class SecureMemoryData : public GpgME::DataProvider
+{
+public:
+    bool isSupported(Operation op) const override
+    {
+        return op == Read || op == Write || op == Seek || op == Release;
+    }
+
+    ssize_t read(void *buffer, size_t bufSize) override;
+    ssize_t write(const void *buffer, size_t bufSize) override;
+    off_t seek(off_t offset, int whence) override;
+
+    void release() override
+    {
+    }
+
+    const SecureByteArray &data() const
+    {
+        return m_data;
+    }
+
+private:
+    SecureByteArray m_data;
+    size_t m_position = 0;
+};
+
+/**
+ * @brief Write-only GpgME::DataProvider that decodes UTF-8 output directly
+ *        into a QString. Multibyte sequences split across two writes are
+ *        kept back until they are complete. Call finish() when done.
+ */
+class Utf8StringWriter : public GpgME::DataProvider
+{
+public:
+    explicit Utf8StringWriter(QString &target_);
+
+    bool isSupported(Operation op) const override
+    {
+        return op == Write || op == Seek || op == Release;
+    }
+
+    ssize_t read(void *buffer, size_t bufSize) override;
+    ssize_t write(const void *buffer, size_t bufSize) override;
+    off_t seek(off_t offset, int whence) override;
+
+    void release() override
+    {
+    }
+
+    // decodes whatever is left (invalid trailing bytes become U+FFFD)
+    void finish();
+
+    // time spent decoding the UTF-8 output
+    qint64 conversionNsecs() const
+    {
+        return m_conversionNsecs;
+    }
+
+    qint64 bytesWritten() const
+    {
+        return m_position;
+    }
+
+private:
+    // length of data_ without a trailing incomplete UTF-8 sequence
+    static size_t completeUtf8Length(const SecureByteArray &data_);
+
+    QString &m_target;
+    // plaintext bytes of an incomplete UTF-8 sequence, at most one write
+    SecureByteArray m_pending;
+    off_t m_position = 0;
+    qint64 m_conversionNsecs = 0;
+};
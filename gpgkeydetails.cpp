@@ -4,26 +4,55 @@
 */
 
 #include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
 
 #include "gpgkeydetails.hpp"
 
+#include <string>
+
+/// local functions
+QString timestampToQString(const time_t timestamp_)
+{
+    QDateTime dt;
+    dt.setSecsSinceEpoch(timestamp_);
+    return dt.toString(QStringLiteral("yyyy-MM-dd"));
+}
+
+// There are only a handful of algorithm names ("rsa4096", "ed25519", ...),
+// so all keys share one QString per name instead of allocating their own.
+QString internedAlgorithmName(const std::string &algoName_)
+{
+    static QMutex mutex;
+    static QHash<QByteArray, QString> names;
+    const QByteArray key = QByteArray::fromStdString(algoName_);
+    QMutexLocker locker(&mutex);
+    auto it = names.constFind(key);
+    if (it == names.constEnd()) {
+        it = names.insert(key, QString::fromLatin1(key));
+    }
+    return it.value();
+}
+
+/// class functions
 GPGKeyDetails::GPGKeyDetails() = default;
 
-GPGKeyDetails::~GPGKeyDetails()
+GPGKeyDetails::GPGKeyDetails(const GpgME::Key &key_)
 {
-    m_uids.clear();
-    m_mailAddresses.clear();
-    m_subkeyIDs.clear();
+    loadFromGPGMeKey(key_);
 }
 
+GPGKeyDetails::~GPGKeyDetails() = default;
+
 QString GPGKeyDetails::fingerPrint() const
 {
-    return m_fingerPrint;
+    return QString::fromLatin1(m_fingerPrint);
 }
 
 QString GPGKeyDetails::keyID() const
 {
-    return m_keyID;
+    return QString::fromLatin1(m_keyID);
 }
 
 QString GPGKeyDetails::keyType() const
@@ -33,58 +62,63 @@ QString GPGKeyDetails::keyType() const
 
 QString GPGKeyDetails::keyLength() const
 {
-    return m_keyLength;
+    return QString::number(m_keyLength);
 }
 
 QString GPGKeyDetails::creationDate() const
 {
-    return m_creationDate;
+    return timestampToQString(m_creationTime);
 }
 
 QString GPGKeyDetails::expiryDate() const
 {
-    return m_expiryDate;
+    return timestampToQString(m_expirationTime);
 }
 
-const QVector<QString> &GPGKeyDetails::uids() const
+unsigned int GPGKeyDetails::keyLengthBits() const
 {
-    return m_uids;
+    return m_keyLength;
 }
 
-const QVector<QString> &GPGKeyDetails::mailAdresses() const
+time_t GPGKeyDetails::creationTime() const
 {
-    return m_mailAddresses;
+    return m_creationTime;
 }
 
-const QVector<QString> &GPGKeyDetails::subkeyIDs() const
+time_t GPGKeyDetails::expirationTime() const
 {
-    return m_subkeyIDs;
+    return m_expirationTime;
 }
 
-size_t GPGKeyDetails::getNumUIds() const
+const QVector<GPGUserID> &GPGKeyDetails::userIDs() const
 {
-    return m_uids.size();
+    return m_userIDs;
 }
 
-QString timestampToQString(const time_t timestamp_)
+QString GPGKeyDetails::subkeyID() const
 {
-    QDateTime dt;
-    dt.setSecsSinceEpoch(timestamp_);
-    return dt.toString(QStringLiteral("yyyy-MM-dd"));
+    return QString::fromLatin1(m_subkeyID);
+}
+
+size_t GPGKeyDetails::getNumUIds() const
+{
+    return m_userIDs.size();
 }
 
-void GPGKeyDetails::loadFromGPGMeKey(GpgME::Key key_)
+void GPGKeyDetails::loadFromGPGMeKey(const GpgME::Key &key_)
 {
-    m_fingerPrint = QString::fromUtf8(key_.primaryFingerprint());
-    m_keyID = QString::fromUtf8(key_.shortKeyID());
-    m_keyType = QString::fromStdString(key_.subkey(0).algoName());
-    m_keyLength = QString::number(key_.subkey(0).length());
-    m_creationDate = QString(timestampToQString(key_.subkey(0).creationTime()));
-    m_expiryDate = QString(timestampToQString(key_.subkey(0).expirationTime()));
-    const std::vector<GpgME::UserID> &ids = key_.userIDs();
-    for (auto &id : ids) {
-        m_uids.push_back(QString::fromUtf8(id.name()));
-        m_mailAddresses.push_back(QString::fromUtf8(id.email()));
-        m_subkeyIDs.push_back(QString::fromUtf8(key_.subkey(1).keyID()));
+    const GpgME::Subkey primaryKey = key_.subkey(0);
+    m_fingerPrint = QByteArray(key_.primaryFingerprint());
+    m_keyID = QByteArray(key_.shortKeyID());
+    m_subkeyID = QByteArray(key_.subkey(1).keyID());
+    m_keyType = internedAlgorithmName(primaryKey.algoName());
+    m_keyLength = primaryKey.length();
+    m_creationTime = primaryKey.creationTime();
+    m_expirationTime = primaryKey.expirationTime();
+    const std::vector<GpgME::UserID> ids = key_.userIDs();
+    m_userIDs.clear();
+    m_userIDs.reserve(ids.size());
+    for (const auto &id : ids) {
+        m_userIDs.push_back({QString::fromUtf8(id.name()), QString::fromUtf8(id.email())});
     }
 }
@@ -7,17 +7,38 @@
 
 /**
  * @brief This class contains the details for a GPG key
+ *
+ * Only raw values are stored, the strings shown in the key table
+ * are formatted on demand.
  **/
 
 #include <gpgme++/key.h>
 
+#include <QByteArray>
 #include <QString>
 #include <QVector>
 
+#include <ctime>
+
+/**
+ * @brief Name and email address of one user ID of a key
+ */
+struct GPGUserID {
+    QString name;
+    QString email;
+};
+
 class GPGKeyDetails
 {
 public:
     GPGKeyDetails();
+    explicit GPGKeyDetails(const GpgME::Key &key_);
+
+    // loaded once per key and then only moved, never copied
+    GPGKeyDetails(const GPGKeyDetails &) = delete;
+    GPGKeyDetails(GPGKeyDetails &&) noexcept = default;
+    GPGKeyDetails &operator=(const GPGKeyDetails &) = delete;
+    GPGKeyDetails &operator=(GPGKeyDetails &&) noexcept = default;
 
     ~GPGKeyDetails();
 
@@ -27,23 +48,24 @@ public:
     QString keyLength() const;
     QString creationDate() const;
     QString expiryDate() const;
-    const QVector<QString> &uids() const; // this returns a list of all names per key
-    const QVector<QString> &mailAdresses() const; // this returns a list of all email addresses associated with this
-                                                  // key
-    const QVector<QString> &subkeyIDs() const; // this returns a list of all "IDs" per key
+    unsigned int keyLengthBits() const;
+    time_t creationTime() const;
+    time_t expirationTime() const;
+    const QVector<GPGUserID> &userIDs() const; // this returns names and email addresses of all user IDs
+    QString subkeyID() const; // the ID of the first subkey, i.e. the one usually used for encryption
 
     size_t getNumUIds() const;
 
-    void loadFromGPGMeKey(GpgME::Key key_);
+    void loadFromGPGMeKey(const GpgME::Key &key_);
 
 private:
-    QString m_fingerPrint;
-    QString m_keyID;
-    QString m_keyType;
-    QString m_keyLength;
-    QString m_creationDate;
-    QString m_expiryDate;
-    QVector<QString> m_uids;
-    QVector<QString> m_mailAddresses;
-    QVector<QString> m_subkeyIDs;
+    // fingerprints and key IDs are hex strings, Latin-1 needs half the memory of QString
+    QByteArray m_fingerPrint;
+    QByteArray m_keyID;
+    QByteArray m_subkeyID;
+    QString m_keyType; // shared between all keys using the same algorithm
+    unsigned int m_keyLength = 0;
+    time_t m_creationTime = 0;
+    time_t m_expirationTime = 0;
+    QVector<GPGUserID> m_userIDs;
 };
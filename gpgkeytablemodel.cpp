@@ -0,0 +1,253 @@
+/*
+    SPDX-FileCopyrightText: 2025 Dennis Lübke <kde@dennis2society.de>
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "gpgkeytablemodel.hpp"
+
+#include <KLocalizedString>
+
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <utility>
+
+/// local functions
+QString concatenateEmailAddressesToString(const QVector<GPGUserID> &userIDs_, const QString &subkeyID_)
+{
+    QString out = QLatin1String("");
+    for (auto i = 0; i < userIDs_.size(); ++i) {
+        if (i > 0) {
+            out += QLatin1Char('\n');
+        }
+        out += userIDs_.at(i).name + QStringLiteral(" <");
+        out += userIDs_.at(i).email + QStringLiteral("> ");
+        out += QStringLiteral("(") + subkeyID_ + QStringLiteral(")");
+    }
+    return out;
+}
+
+// packs three UTF-16 code units into one hash key
+quint64 trigramAt(const QString &text_, qsizetype pos_)
+{
+    return (quint64(text_.at(pos_).unicode()) << 32) | (quint64(text_.at(pos_ + 1).unicode()) << 16) | quint64(text_.at(pos_ + 2).unicode());
+}
+
+QVector<int> intersectSortedRows(const QVector<int> &a_, const QVector<int> &b_)
+{
+    QVector<int> result;
+    std::set_intersection(a_.cbegin(), a_.cend(), b_.cbegin(), b_.cend(), std::back_inserter(result));
+    return result;
+}
+
+/// class functions
+GPGKeyTableModel::GPGKeyTableModel(QObject *parent_)
+    : QAbstractTableModel(parent_)
+{
+}
+
+GPGKeyTableModel::~GPGKeyTableModel() = default;
+
+void GPGKeyTableModel::setKeys(std::vector<GPGKeyDetails> &&keys_)
+{
+    beginResetModel();
+    m_keys = std::move(keys_);
+    endResetModel();
+}
+
+const GPGKeyDetails &GPGKeyTableModel::keyAt(int row_) const
+{
+    return m_keys.at(row_);
+}
+
+int GPGKeyTableModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : int(m_keys.size());
+}
+
+int GPGKeyTableModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant GPGKeyTableModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || size_t(index.row()) >= m_keys.size()) {
+        return QVariant();
+    }
+    if (role != Qt::DisplayRole && role != Qt::ToolTipRole) {
+        return QVariant();
+    }
+    // cell texts are built on demand, i.e. only for rows that get painted
+    const GPGKeyDetails &key = m_keys.at(index.row());
+    switch (index.column()) {
+    case FingerprintColumn:
+        return key.fingerPrint();
+    case CreationDateColumn:
+        return key.creationDate();
+    case ExpiryDateColumn:
+        return key.expiryDate();
+    case KeyLengthColumn:
+        return key.keyLength();
+    case UserIDsColumn:
+        // rows have a fixed height, the display text is the first UID only
+        if (role == Qt::DisplayRole && key.userIDs().size() > 1) {
+            return i18nc("first user ID of a key, (+number of further user IDs)",
+                         "%1 (+%2)",
+                         concatenateEmailAddressesToString(key.userIDs().mid(0, 1), key.subkeyID()),
+                         key.userIDs().size() - 1);
+        }
+        return concatenateEmailAddressesToString(key.userIDs(), key.subkeyID());
+    default:
+        return QVariant();
+    }
+}
+
+QVariant GPGKeyTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+    switch (section) {
+    case FingerprintColumn:
+        return i18n("Key Fingerprint");
+    case CreationDateColumn:
+        return i18n("Creation Date");
+    case ExpiryDateColumn:
+        return i18n("Expiry Date");
+    case KeyLengthColumn:
+        return i18n("Key Length");
+    case UserIDsColumn:
+        return i18n("User IDs");
+    default:
+        return QVariant();
+    }
+}
+
+GPGKeyFilterProxyModel::GPGKeyFilterProxyModel(QObject *parent_)
+    : QSortFilterProxyModel(parent_)
+{
+}
+
+GPGKeyFilterProxyModel::~GPGKeyFilterProxyModel() = default;
+
+void GPGKeyFilterProxyModel::setSourceModel(QAbstractItemModel *sourceModel_)
+{
+    if (sourceModel()) {
+        disconnect(sourceModel(), nullptr, this, nullptr);
+    }
+    QSortFilterProxyModel::setSourceModel(sourceModel_);
+    // The base class has already re-filtered with the outdated index
+    // when this is called, so the search is applied once more.
+    connect(sourceModel_, &QAbstractItemModel::modelReset, this, [this]() {
+        rebuildIndex();
+        applySearchString(m_searchString);
+    });
+    rebuildIndex();
+}
+
+void GPGKeyFilterProxyModel::rebuildIndex()
+{
+    m_searchTexts.clear();
+    m_trigramIndex.clear();
+    m_matchingRows.clear();
+    m_rowMatches.clear();
+    const GPGKeyTableModel *keyModel = qobject_cast<const GPGKeyTableModel *>(sourceModel());
+    if (!keyModel) {
+        return;
+    }
+    const int numRows = keyModel->rowCount();
+    m_searchTexts.reserve(numRows);
+    for (int row = 0; row < numRows; ++row) {
+        const GPGKeyDetails &key = keyModel->keyAt(row);
+        QString text;
+        for (const GPGUserID &uid : key.userIDs()) {
+            text += uid.name + QLatin1Char('\n') + uid.email + QLatin1Char('\n');
+        }
+        // like gpg's key search, a (part of the) fingerprint or key ID matches too
+        text += key.fingerPrint() + QLatin1Char('\n') + key.subkeyID() + QLatin1Char('\n');
+        text = text.toLower();
+        for (qsizetype pos = 0; pos + 2 < text.size(); ++pos) {
+            QVector<int> &rows = m_trigramIndex[trigramAt(text, pos)];
+            // rows are visited in ascending order, so this keeps the lists sorted and unique
+            if (rows.isEmpty() || rows.constLast() != row) {
+                rows.append(row);
+            }
+        }
+        m_searchTexts.append(text);
+    }
+    m_rowMatches.fill(true, numRows);
+}
+
+QVector<int> GPGKeyFilterProxyModel::findCandidates(const QString &searchString_) const
+{
+    // the rows containing every trigram of the search string
+    QVector<int> candidates;
+    for (qsizetype pos = 0; pos + 2 < searchString_.size(); ++pos) {
+        const auto it = m_trigramIndex.constFind(trigramAt(searchString_, pos));
+        if (it == m_trigramIndex.constEnd()) {
+            return QVector<int>();
+        }
+        candidates = pos == 0 ? it.value() : intersectSortedRows(candidates, it.value());
+        if (candidates.isEmpty()) {
+            break;
+        }
+    }
+    return candidates;
+}
+
+void GPGKeyFilterProxyModel::setSearchString(const QString &searchString_)
+{
+    QString searchString = searchString_.toLower();
+    // 0x1234ABCD style key IDs
+    if (searchString.size() > 2 && searchString.startsWith(QLatin1String("0x"))) {
+        bool isHex = false;
+        searchString.mid(2, 8).toUInt(&isHex, 16);
+        if (isHex) {
+            searchString.remove(0, 2);
+        }
+    }
+    if (searchString == m_searchString) {
+        return;
+    }
+    applySearchString(searchString);
+}
+
+void GPGKeyFilterProxyModel::applySearchString(const QString &searchString_)
+{
+    const int numRows = m_searchTexts.size();
+    if (searchString_.isEmpty()) {
+        m_matchingRows.clear();
+        m_rowMatches.fill(true, numRows);
+    } else {
+        QVector<int> candidates;
+        if (!m_searchString.isEmpty() && searchString_ != m_searchString && searchString_.contains(m_searchString)) {
+            // the query got extended: only the previous matches can still match
+            candidates = m_matchingRows;
+        } else if (searchString_.size() >= 3) {
+            candidates = findCandidates(searchString_);
+        } else {
+            // too short for the trigram index
+            candidates.resize(numRows);
+            std::iota(candidates.begin(), candidates.end(), 0);
+        }
+        m_matchingRows.clear();
+        for (const int row : std::as_const(candidates)) {
+            if (m_searchTexts.at(row).contains(searchString_)) {
+                m_matchingRows.append(row);
+            }
+        }
+        m_rowMatches.fill(false, numRows);
+        for (const int row : std::as_const(m_matchingRows)) {
+            m_rowMatches[row] = true;
+        }
+    }
+    m_searchString = searchString_;
+    invalidateFilter();
+}
+
+bool GPGKeyFilterProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
+{
+    Q_UNUSED(sourceParent);
+    return sourceRow < m_rowMatches.size() ? m_rowMatches.at(sourceRow) : true;
+}
@@ -0,0 +1,98 @@
+/*
+    SPDX-FileCopyrightText: 2025 Dennis Lübke <kde@dennis2society.de>
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#pragma once
+
+/**
+ * @brief Table model presenting the keys loaded by GPGMeWrapper.
+ * It takes over the key vector of the wrapper, so setting new keys
+ * does not copy any key details. Searching and
+ * sorting is done by GPGKeyFilterProxyModel on top of it.
+ */
+
+#include "gpgkeydetails.hpp"
+
+#include <QAbstractTableModel>
+#include <QHash>
+#include <QSortFilterProxyModel>
+#include <QVector>
+
+#include <vector>
+
+class GPGKeyTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column {
+        FingerprintColumn = 0,
+        CreationDateColumn,
+        ExpiryDateColumn,
+        KeyLengthColumn,
+        UserIDsColumn,
+        ColumnCount
+    };
+
+    explicit GPGKeyTableModel(QObject *parent_ = nullptr);
+
+    ~GPGKeyTableModel() override;
+
+    /**
+     * @brief Replaces the presented keys (i.e. GPGMeWrapper::takeKeys()).
+     */
+    void setKeys(std::vector<GPGKeyDetails> &&keys_);
+
+    const GPGKeyDetails &keyAt(int row_) const;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+private:
+    std::vector<GPGKeyDetails> m_keys;
+};
+
+/**
+ * @brief Sorts the keys and filters them by a search string matched
+ * case insensitively against the names, mail addresses, fingerprints and
+ * key IDs of the keys. These texts are indexed by character trigrams when
+ * the keys are set, so a search only verifies the keys that contain all
+ * trigrams of the search string. Extending the previous search string
+ * only narrows down the previous result.
+ */
+class GPGKeyFilterProxyModel : public QSortFilterProxyModel
+{
+    Q_OBJECT
+
+public:
+    explicit GPGKeyFilterProxyModel(QObject *parent_ = nullptr);
+
+    ~GPGKeyFilterProxyModel() override;
+
+    void setSourceModel(QAbstractItemModel *sourceModel_) override;
+
+    void setSearchString(const QString &searchString_);
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
+
+private:
+    void rebuildIndex();
+    // expects a lower case search string
+    void applySearchString(const QString &searchString_);
+    QVector<int> findCandidates(const QString &searchString_) const;
+
+    // lower case names and mail addresses per source row
+    QVector<QString> m_searchTexts;
+    // trigram -> ascending source rows containing it
+    QHash<quint64, QVector<int>> m_trigramIndex;
+
+    QString m_searchString;
+    // ascending source rows matching m_searchString
+    QVector<int> m_matchingRows;
+    // m_matchingRows as lookup table for filterAcceptsRow()
+    QVector<bool> m_rowMatches;
+};
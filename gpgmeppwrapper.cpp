@@ -7,20 +7,48 @@
 #include <gpgme++/data.h>
 #include <gpgme++/decryptionresult.h>
 #include <gpgme++/encryptionresult.h>
+#include <gpgme++/global.h>
 #include <gpgme++/gpgmepp_version.h>
+#include <gpgme++/interfaces/dataprovider.h>
+#include <gpgme++/interfaces/progressprovider.h>
 #include <gpgme++/key.h>
 #include <gpgme++/keylistresult.h>
 
+#include "gpgdataproviders.hpp"
 #include "gpgmeppwrapper.hpp"
+#include "securememory.hpp"
 
 #include <KLocalizedString>
+#include <KTextEditor/Document>
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <utility>
 #include <vector>
 
 // This is needed to distinguish GPGMe++ versions
 #define GPGMEPP_VERSION_NUMBER (GPGMEPP_VERSION_MAJOR * 10000 + GPGMEPP_VERSION_MINOR * 100 + GPGMEPP_VERSION_PATCH)
 
+Q_LOGGING_CATEGORY(KATE_GPG_TIMING, "kate.gpgplugin.timing", QtWarningMsg)
+
 /// local functions
+
 QVector<QString> getUIDsForKey(GpgME::Key key)
 {
     QVector<QString> result;
@@ -30,17 +58,283 @@ QVector<QString> getUIDsForKey(GpgME::Key key)
     return result;
 }
 
+// Set in the pool threads that work for the running asynchronous operation
+// (see decryptStringsAsync()), their contexts can be cancelled as well.
+thread_local bool isOperationWorkerThread = false;
+
+/**
+ * @brief Registers the context of an asynchronous operation so that
+ *        cancelOperation() can reach it, and forwards GpgME's progress
+ *        callbacks as operationProgress(). Synchronous calls (i.e. not
+ *        running in the operation thread) are left untouched.
+ */
+class GPGMeWrapper::OperationScope : public GpgME::ProgressProvider
+{
+public:
+    OperationScope(GPGMeWrapper *wrapper_, GPGContextPool::ContextHandle &ctx_)
+        : m_wrapper(wrapper_)
+        , m_ctx(ctx_)
+        , m_reportsProgress(wrapper_->isOperationThread())
+        , m_active(m_reportsProgress || isOperationWorkerThread)
+    {
+        if (!m_active) {
+            return;
+        }
+        QMutexLocker locker(&m_wrapper->m_operationMutex);
+        m_wrapper->m_activeContexts.insert(m_ctx.get());
+        // parallel workers report their progress per job instead
+        if (m_reportsProgress) {
+            m_ctx->setProgressProvider(this);
+        }
+    }
+
+    ~OperationScope() override
+    {
+        if (!m_active) {
+            return;
+        }
+        QMutexLocker locker(&m_wrapper->m_operationMutex);
+        m_wrapper->m_activeContexts.remove(m_ctx.get());
+        m_ctx->setProgressProvider(nullptr);
+        // a context that got a cancel request is not handed out again
+        if (m_wrapper->m_cancelRequested) {
+            m_ctx.get_deleter().reuse = false;
+        }
+    }
+
+    // true if cancelOperation() was called before the context got registered
+    bool isCancelled() const
+    {
+        if (!m_active) {
+            return false;
+        }
+        QMutexLocker locker(&m_wrapper->m_operationMutex);
+        return m_wrapper->m_cancelRequested;
+    }
+
+    void showProgress(const char *what, int type, int current, int total) override
+    {
+        Q_UNUSED(type);
+        Q_EMIT m_wrapper->operationProgress(what ? QString::fromUtf8(what) : QString(), current, total);
+    }
+
+private:
+    GPGMeWrapper *m_wrapper;
+    GPGContextPool::ContextHandle &m_ctx;
+    const bool m_reportsProgress;
+    const bool m_active;
+};
+
+// Conversion done by a data provider happens while GpgME works,
+// i.e. it got measured as part of the crypto phase.
+void moveToConversionTime(GPGOperationTimings &timings_, qint64 conversionNsecs_)
+{
+    const qint64 conversionUs = conversionNsecs_ / 1000;
+    timings_.conversionUs += conversionUs;
+    timings_.cryptoUs = qMax<qint64>(0, timings_.cryptoUs - conversionUs);
+}
+
+QDateTime lastModified(const QString &path_)
+{
+    const QFileInfo info(path_);
+    return info.exists() ? info.lastModified() : QDateTime();
+}
+
 /// class functions
-GPGMeWrapper::GPGMeWrapper()
+GPGOperationTimings &GPGOperationTimings::operator+=(const GPGOperationTimings &other_)
+{
+    keyLookupUs += other_.keyLookupUs;
+    contextSetupUs += other_.contextSetupUs;
+    cryptoUs += other_.cryptoUs;
+    conversionUs += other_.conversionUs;
+    documentUpdateUs += other_.documentUpdateUs;
+    inputBytes += other_.inputBytes;
+    outputBytes += other_.outputBytes;
+    return *this;
+}
+
+QString GPGOperationTimings::toString() const
 {
-    loadKeys(false, true, QLatin1String(""));
+    const auto ms = [](qint64 us_) {
+        return QString::number(us_ / 1000.0, 'f', 1);
+    };
+    return i18n("key lookup %1 ms, context setup %2 ms, crypto %3 ms, conversion %4 ms, document update %5 ms, %6 bytes in, %7 bytes out",
+                ms(keyLookupUs),
+                ms(contextSetupUs),
+                ms(cryptoUs),
+                ms(conversionUs),
+                ms(documentUpdateUs),
+                inputBytes,
+                outputBytes);
+}
+
+GPGMeWrapper::GPGMeWrapper(QObject *parent_)
+    : QObject(parent_)
+{
+    m_keyringChangedTimer = new QTimer(this);
+    m_keyringChangedTimer->setSingleShot(true);
+    m_keyringChangedTimer->setInterval(200);
+    // the old cache stays in use until the new one is loaded
+    connect(m_keyringChangedTimer, &QTimer::timeout, this, &GPGMeWrapper::loadKeyCacheAsync);
+    m_gpgHomeWatcher = new QFileSystemWatcher(this);
+    connect(m_gpgHomeWatcher, &QFileSystemWatcher::fileChanged, this, &GPGMeWrapper::onGPGHomeDirChanged);
+    connect(m_gpgHomeWatcher, &QFileSystemWatcher::directoryChanged, this, &GPGMeWrapper::onGPGHomeDirChanged);
+    watchGPGHomeDir();
+    m_plaintextCacheTimer = new QTimer(this);
+    m_plaintextCacheTimer->setInterval(30 * 1000);
+    connect(m_plaintextCacheTimer, &QTimer::timeout, this, [this]() {
+        m_plaintextCache.removeExpired();
+    });
+    // The keys are not loaded here, listing a large keyring takes a while.
+    // Call loadKeyCacheAsync() (or loadKeys() if blocking is acceptable).
 }
 
 GPGMeWrapper::~GPGMeWrapper()
 {
+    if (m_operationThread) {
+        cancelOperation();
+        m_operationThread->wait();
+    }
+    if (m_keyLoadThread) {
+        m_keyLoadThread->wait();
+    }
     m_keys.clear();
 }
 
+bool GPGMeWrapper::startOperation(const std::function<GPGOperationResult()> &job_, void (GPGMeWrapper::*finishedSignal_)(const GPGOperationResult &))
+{
+    if (m_operationThread) {
+        return false;
+    }
+    {
+        QMutexLocker locker(&m_operationMutex);
+        m_cancelRequested = false;
+    }
+    QThread *thread = QThread::create([this, job_, finishedSignal_]() {
+        const GPGOperationResult result = job_();
+        // deliver the result in the thread owning the wrapper (the GUI thread)
+        QMetaObject::invokeMethod(
+            this,
+            [this, result, finishedSignal_]() {
+                m_operationThread = nullptr;
+                Q_EMIT(this->*finishedSignal_)(result);
+            },
+            Qt::QueuedConnection);
+    });
+    connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+    m_operationThread = thread;
+    thread->start();
+    return true;
+}
+
+bool GPGMeWrapper::decryptStringAsync(const QString &inputString_, const QString &fingerprint_)
+{
+    return startOperation(
+        [this, inputString_, fingerprint_]() {
+            return decryptString(inputString_, fingerprint_);
+        },
+        &GPGMeWrapper::decryptionFinished);
+}
+
+bool GPGMeWrapper::encryptStringAsync(const QString &inputString_,
+                                      const QStringList &fingerprints_,
+                                      const QString &recipientMail_,
+                                      const bool useASCII,
+                                      bool symmetricEncryption_,
+                                      bool showOnlyPrivateKeys_)
+{
+    return startOperation(
+        [=, this]() {
+            return encryptString(inputString_, fingerprints_, recipientMail_, useASCII, symmetricEncryption_, showOnlyPrivateKeys_);
+        },
+        &GPGMeWrapper::encryptionFinished);
+}
+
+void GPGMeWrapper::runConcurrently(int count_, int maxThreads_, std::vector<GPGOperationResult> &results_, const std::function<void(int)> &job_)
+{
+    // jobs skipped because of cancelOperation() keep this result
+    for (GPGOperationResult &result : results_) {
+        result.cancelled = true;
+    }
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, maxThreads_));
+    for (int i = 0; i < count_; ++i) {
+        pool.start([this, &job_, i]() {
+            bool cancelled = false;
+            {
+                QMutexLocker locker(&m_operationMutex);
+                cancelled = m_cancelRequested;
+            }
+            if (cancelled) {
+                return;
+            }
+            isOperationWorkerThread = true;
+            job_(i);
+            isOperationWorkerThread = false;
+        });
+    }
+    pool.waitForDone();
+}
+
+bool GPGMeWrapper::decryptStringsAsync(const QStringList &inputStrings_, const QString &fingerprint_)
+{
+    return startOperation(
+        [this, inputStrings_, fingerprint_]() {
+            // Every job borrows its own context from the pool, gpg-agent
+            // caches the passphrase after the first prompt.
+            std::vector<GPGOperationResult> results(inputStrings_.size());
+            std::atomic<int> numFinished(0);
+            runConcurrently(inputStrings_.size(), QThread::idealThreadCount(), results, [&](int i) {
+                results[i] = decryptString(inputStrings_.at(i), fingerprint_);
+                Q_EMIT operationProgress(QStringLiteral("blocks"), ++numFinished, inputStrings_.size());
+            });
+
+            GPGOperationResult summary;
+            summary.keyFound = true;
+            summary.decryptionSuccess = true;
+            for (int i = 0; i < inputStrings_.size(); ++i) {
+                GPGOperationResult &res = results[i];
+                summary.timings += res.timings;
+                summary.cancelled = summary.cancelled || res.cancelled;
+                if (res.decryptionSuccess) {
+                    if (summary.keyIDUsedForDecryption.isEmpty()) {
+                        summary.keyIDUsedForDecryption = res.keyIDUsedForDecryption;
+                    }
+                    summary.resultStrings.append(std::move(res.resultString));
+                    continue;
+                }
+                summary.keyFound = summary.keyFound && res.keyFound;
+                summary.decryptionSuccess = false;
+                summary.resultStrings.append(QString());
+                if (!res.cancelled) {
+                    summary.errorMessage.append(i18n("Block %1: %2", i + 1, res.errorMessage) + QLatin1Char('\n'));
+                }
+            }
+            return summary;
+        },
+        &GPGMeWrapper::decryptionOfStringsFinished);
+}
+
+void GPGMeWrapper::cancelOperation()
+{
+    QMutexLocker locker(&m_operationMutex);
+    m_cancelRequested = true;
+    // gpgme_cancel_async() is safe to call from another thread
+    for (GpgME::Context *ctx : std::as_const(m_activeContexts)) {
+        ctx->cancelPendingOperation();
+    }
+}
+
+bool GPGMeWrapper::isOperationRunning() const
+{
+    return m_operationThread != nullptr;
+}
+
+bool GPGMeWrapper::isOperationThread() const
+{
+    return QThread::currentThread() == m_operationThread;
+}
+
 uint GPGMeWrapper::selectedKeyIndex() const
 {
     return m_selectedKeyIndex;
@@ -51,17 +345,88 @@ void GPGMeWrapper::setSelectedKeyIndex(uint newSelectedKeyIndex)
     m_selectedKeyIndex = newSelectedKeyIndex;
 }
 
+GPGCompression GPGMeWrapper::compression() const
+{
+    return m_compression;
+}
+
+void GPGMeWrapper::setCompression(GPGCompression compression_)
+{
+    m_compression = compression_;
+}
+
+void GPGMeWrapper::setPlaintextCacheEnabled(bool enabled_, int timeToLiveSeconds_)
+{
+    m_plaintextCacheEnabled = enabled_;
+    m_plaintextCache.setTimeToLive(qint64(timeToLiveSeconds_) * 1000);
+    if (enabled_) {
+        m_plaintextCacheTimer->start();
+    } else {
+        m_plaintextCacheTimer->stop();
+        m_plaintextCache.clear();
+    }
+}
+
+void GPGMeWrapper::clearPlaintextCache()
+{
+    m_plaintextCache.clear();
+}
+
+bool GPGMeWrapper::findCachedPlaintext(const QByteArray &digest_, GPGOperationResult &result_)
+{
+    if (!m_plaintextCacheEnabled || !m_plaintextCache.find(digest_, result_.resultString, result_.keyIDUsedForDecryption)) {
+        return false;
+    }
+    result_.keyFound = true;
+    result_.decryptionSuccess = true;
+    qCDebug(KATE_GPG_TIMING) << "plaintext cache hit, decryption skipped";
+    return true;
+}
+
+void GPGMeWrapper::cachePlaintext(const QByteArray &digest_, const GPGOperationResult &result_)
+{
+    if (m_plaintextCacheEnabled && result_.decryptionSuccess) {
+        m_plaintextCache.insert(digest_, result_.resultString, result_.keyIDUsedForDecryption);
+    }
+}
+
+bool GPGMeWrapper::isCompressedData(const QByteArray &data_)
+{
+    static const QByteArray signatures[] = {
+        QByteArrayLiteral("\x1f\x8b"), // gzip
+        QByteArrayLiteral("BZh"), // bzip2
+        QByteArrayLiteral("\xfd" "7zXZ"), // xz
+        QByteArrayLiteral("\x28\xb5\x2f\xfd"), // zstd
+        QByteArrayLiteral("PK\x03\x04"), // zip, docx, odt, jar, ...
+        QByteArrayLiteral("7z\xbc\xaf\x27\x1c"), // 7z
+        QByteArrayLiteral("Rar!"), // rar
+        QByteArrayLiteral("\xff\xd8\xff"), // JPEG
+        QByteArrayLiteral("\x89PNG"), // PNG
+    };
+    for (const QByteArray &signature : signatures) {
+        if (data_.startsWith(signature)) {
+            return true;
+        }
+    }
+    // encrypted OpenPGP data does not compress either
+    return hasEncryptedPacketHeader(data_);
+}
+
 std::vector<GpgME::Key> GPGMeWrapper::listKeys(bool showOnlyPrivateKeys_, const QString &searchPattern_)
 {
     GpgME::Error err;
-    GpgME::Protocol protocol = GpgME::OpenPGP;
-    GpgME::initializeLibrary();
-    auto ctx = std::unique_ptr<GpgME::Context>(GpgME::Context::createForProtocol(protocol));
+    auto ctx = m_contextPool.acquire(false, false);
+    std::vector<GpgME::Key> keys;
+    if (!ctx) {
+        return keys;
+    }
     unsigned int mode = 0;
     ctx->setKeyListMode(mode);
-    std::vector<GpgME::Key> keys;
     err = ctx->startKeyListing(searchPattern_.toUtf8().constData(), showOnlyPrivateKeys_);
     if (err) {
+        // a half started listing must not leak into the next operation
+        ctx->endKeyListing();
+        ctx.get_deleter().reuse = false;
         return keys;
     }
     while (true) {
@@ -71,44 +436,236 @@ std::vector<GpgME::Key> GPGMeWrapper::listKeys(bool showOnlyPrivateKeys_, const
         }
         keys.push_back(key);
     };
+    ctx->endKeyListing();
     return keys;
 }
 
+void GPGMeWrapper::watchGPGHomeDir()
+{
+    const char *homeDir = GpgME::dirInfo("homedir");
+    m_gpgHomeDir = homeDir ? QString::fromUtf8(homeDir) : QDir::homePath() + QStringLiteral("/.gnupg");
+    // The home dir itself is watched because gpg replaces pubring.kbx
+    // by renaming a temporary file, which ends a plain file watch.
+    const QStringList paths = {m_gpgHomeDir,
+                               m_gpgHomeDir + QStringLiteral("/pubring.kbx"),
+                               m_gpgHomeDir + QStringLiteral("/pubring.gpg"),
+                               m_gpgHomeDir + QStringLiteral("/private-keys-v1.d")};
+    for (const QString &path : paths) {
+        if (QFileInfo::exists(path) && !m_gpgHomeWatcher->files().contains(path) && !m_gpgHomeWatcher->directories().contains(path)) {
+            m_gpgHomeWatcher->addPath(path);
+        }
+    }
+}
+
+void GPGMeWrapper::onGPGHomeDirChanged()
+{
+    // re-add files that got replaced
+    watchGPGHomeDir();
+    if (!m_keyCacheValid && !m_keyLoadThread) {
+        return; // nothing cached yet, the next loadKeys() reads the keyring anyway
+    }
+    // gpg touches other files in its home dir (random_seed, trustdb.gpg, ...)
+    // on almost every operation, only changes to the keyrings matter here.
+    QDateTime publicKeyring = lastModified(m_gpgHomeDir + QStringLiteral("/pubring.kbx"));
+    if (!publicKeyring.isValid()) {
+        publicKeyring = lastModified(m_gpgHomeDir + QStringLiteral("/pubring.gpg"));
+    }
+    const QDateTime privateKeys = lastModified(m_gpgHomeDir + QStringLiteral("/private-keys-v1.d"));
+    if (publicKeyring != m_publicKeyringTimestamp || privateKeys != m_privateKeysTimestamp) {
+        m_keyringChangedTimer->start();
+    }
+}
+
+void GPGMeWrapper::invalidateKeyCache()
+{
+    m_keyCacheValid = false;
+    m_keyCache.clear();
+    m_secretKeyFingerprints.clear();
+    QMutexLocker locker(&m_fingerprintIndexMutex);
+    m_fingerprintIndex.reset();
+}
+
+GpgME::Key GPGMeWrapper::findKey(GpgME::Context *ctx_, const QString &fingerprint_, bool secretOnly_, GpgME::Error &err_)
+{
+    const QByteArray fingerprint = fingerprint_.toLatin1().toUpper();
+    std::shared_ptr<const FingerprintIndex> index;
+    {
+        QMutexLocker locker(&m_fingerprintIndexMutex);
+        index = m_fingerprintIndex;
+    }
+    if (index) {
+        const auto it = index->keys.constFind(fingerprint);
+        if (it != index->keys.constEnd() && (!secretOnly_ || index->secretKeyFingerprints.contains(fingerprint))) {
+            return it.value();
+        }
+    }
+    // not cached (yet), e.g. the cache is still loading or the key was just imported
+    return ctx_->key(fingerprint.constData(), err_, secretOnly_);
+}
+
+GPGMeWrapper::KeyringSnapshot GPGMeWrapper::readKeyring(const QString &gpgHomeDir_)
+{
+    QElapsedTimer timer;
+    timer.start();
+    KeyringSnapshot snapshot;
+    // timestamps first: a change during the listing then triggers another reload
+    snapshot.publicKeyringTimestamp = lastModified(gpgHomeDir_ + QStringLiteral("/pubring.kbx"));
+    if (!snapshot.publicKeyringTimestamp.isValid()) {
+        snapshot.publicKeyringTimestamp = lastModified(gpgHomeDir_ + QStringLiteral("/pubring.gpg"));
+    }
+    snapshot.privateKeysTimestamp = lastModified(gpgHomeDir_ + QStringLiteral("/private-keys-v1.d"));
+    snapshot.keys = listKeys(false);
+    for (const GpgME::Key &key : listKeys(true)) {
+        snapshot.secretKeyFingerprints.insert(QByteArray(key.primaryFingerprint()));
+    }
+    auto index = std::make_shared<FingerprintIndex>();
+    index->keys.reserve(snapshot.keys.size());
+    for (const GpgME::Key &key : snapshot.keys) {
+        index->keys.insert(QByteArray(key.primaryFingerprint()), key);
+    }
+    index->secretKeyFingerprints = snapshot.secretKeyFingerprints;
+    snapshot.fingerprintIndex = std::move(index);
+    qCDebug(KATE_GPG_TIMING) << "reading the keyring:" << snapshot.keys.size() << "keys," << snapshot.secretKeyFingerprints.size() << "secret keys in"
+                             << timer.elapsed() << "ms";
+    return snapshot;
+}
+
+void GPGMeWrapper::installKeyCache(KeyringSnapshot &&snapshot_)
+{
+    m_keyCache = std::move(snapshot_.keys);
+    m_secretKeyFingerprints = std::move(snapshot_.secretKeyFingerprints);
+    m_publicKeyringTimestamp = snapshot_.publicKeyringTimestamp;
+    m_privateKeysTimestamp = snapshot_.privateKeysTimestamp;
+    m_keyCacheValid = true;
+    QMutexLocker locker(&m_fingerprintIndexMutex);
+    m_fingerprintIndex = std::move(snapshot_.fingerprintIndex);
+}
+
+void GPGMeWrapper::refreshKeyCache()
+{
+    installKeyCache(readKeyring(m_gpgHomeDir));
+}
+
+void GPGMeWrapper::loadKeyCacheAsync()
+{
+    if (m_keyLoadThread) {
+        // the keyring changed while it was being read
+        m_keyCacheReloadPending = true;
+        return;
+    }
+    m_keyCacheReloadPending = false;
+    const QString gpgHomeDir = m_gpgHomeDir;
+    QThread *thread = QThread::create([this, gpgHomeDir]() {
+        auto snapshot = std::make_shared<KeyringSnapshot>(readKeyring(gpgHomeDir));
+        QMetaObject::invokeMethod(
+            this,
+            [this, snapshot]() {
+                m_keyLoadThread = nullptr;
+                installKeyCache(std::move(*snapshot));
+                Q_EMIT keysChanged();
+                if (m_keyCacheReloadPending) {
+                    loadKeyCacheAsync();
+                }
+            },
+            Qt::QueuedConnection);
+    });
+    connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+    m_keyLoadThread = thread;
+    thread->start();
+}
+
+bool GPGMeWrapper::isLoadingKeys() const
+{
+    return m_keyLoadThread != nullptr;
+}
+
+QString GPGMeWrapper::defaultSecretKeyFingerprint() const
+{
+    for (const GpgME::Key &key : m_keyCache) {
+        if (key.isExpired() || key.isRevoked() || key.isDisabled() || key.isInvalid() || !key.canEncrypt()) {
+            continue;
+        }
+        if (m_secretKeyFingerprints.contains(QByteArray(key.primaryFingerprint()))) {
+            return QString::fromLatin1(key.primaryFingerprint());
+        }
+    }
+    return QString();
+}
+
+bool GPGMeWrapper::matchesSearchPattern(const GpgME::Key &key_, const QString &searchPattern_) const
+{
+    // mimics gpg's default pattern matching: a case insensitive
+    // substring of any user ID or a (part of the) fingerprint
+    if (searchPattern_.isEmpty()) {
+        return true;
+    }
+    for (const GpgME::UserID &uid : key_.userIDs()) {
+        if (QString::fromUtf8(uid.id()).contains(searchPattern_, Qt::CaseInsensitive)) {
+            return true;
+        }
+    }
+    QString hexPattern = searchPattern_;
+    if (hexPattern.startsWith(QLatin1String("0x"), Qt::CaseInsensitive)) {
+        hexPattern.remove(0, 2);
+    }
+    return QString::fromLatin1(key_.primaryFingerprint()).contains(hexPattern, Qt::CaseInsensitive);
+}
+
 void GPGMeWrapper::loadKeys(bool showOnlyPrivateKeys_, bool hideExpiredKeys_, const QString searchPattern_)
 {
+    QElapsedTimer timer;
+    timer.start();
     m_keys.clear();
+    if (!m_keyCacheValid) {
+        if (m_keyLoadThread) {
+            return; // no keys until the background loading is done, see keysChanged()
+        }
+        refreshKeyCache();
+    }
+    const qint64 keyListingMs = timer.restart();
     GPGOperationResult result;
-    const std::vector<GpgME::Key> keys = listKeys(showOnlyPrivateKeys_, searchPattern_);
-    if (keys.size() == 0) {
+    if (m_keyCache.size() == 0) {
         result.errorMessage.append(i18n("Error! No keys found..."));
         return;
     }
-    for (auto key = keys.begin(); key != keys.end(); ++key) {
+    m_keys.reserve(m_keyCache.size());
+    for (auto key = m_keyCache.begin(); key != m_keyCache.end(); ++key) {
         if (hideExpiredKeys_) {
             if (key->isExpired()) {
                 continue;
             }
         }
-        GPGKeyDetails d;
-        d.loadFromGPGMeKey(*key);
-        m_keys.push_back(d);
+        if (showOnlyPrivateKeys_ && !m_secretKeyFingerprints.contains(QByteArray(key->primaryFingerprint()))) {
+            continue;
+        }
+        if (!matchesSearchPattern(*key, searchPattern_)) {
+            continue;
+        }
+        m_keys.emplace_back(*key);
     }
+    qCDebug(KATE_GPG_TIMING) << "loadKeys: key listing" << keyListingMs << "ms, filtering and conversion of" << m_keys.size() << "keys" << timer.elapsed()
+                             << "ms";
 }
 
-const QVector<GPGKeyDetails> &GPGMeWrapper::getKeys() const
+const std::vector<GPGKeyDetails> &GPGMeWrapper::getKeys() const
 {
     return m_keys;
 }
 
+std::vector<GPGKeyDetails> GPGMeWrapper::takeKeys()
+{
+    return std::exchange(m_keys, std::vector<GPGKeyDetails>());
+}
+
 uint GPGMeWrapper::getNumKeys() const
 {
     return m_keys.size();
 }
 
-bool GPGMeWrapper::isPreferredKey(const GPGKeyDetails d_, const QString &mailAddress_)
+bool GPGMeWrapper::isPreferredKey(const GPGKeyDetails &d_, const QString &mailAddress_)
 {
-    for (auto &it : d_.mailAdresses()) {
-        if (it.contains(mailAddress_)) {
+    for (auto &it : d_.userIDs()) {
+        if (it.email.contains(mailAddress_)) {
             return true;
         }
     }
@@ -116,18 +673,89 @@ bool GPGMeWrapper::isPreferredKey(const GPGKeyDetails d_, const QString &mailAdd
 }
 
 const GPGOperationResult GPGMeWrapper::decryptString(const QString &inputString_, const QString &fingerprint_)
+{
+    QElapsedTimer timer;
+    timer.start();
+    // The only conversion of the ciphertext. GpgME needs its length in
+    // bytes, not in UTF-16 code units: armored text is ASCII, but with
+    // any multibyte character in the text the QString size would cut off
+    // the end of the message.
+    const QByteArray bar = inputString_.toUtf8();
+    // with the cache enabled the hashing is part of the conversion time
+    const QByteArray digest = m_plaintextCacheEnabled ? PlaintextCache::digest(bar) : QByteArray();
+    const qint64 conversionUs = timer.nsecsElapsed() / 1000;
+    GPGOperationResult result;
+    if (!digest.isEmpty() && findCachedPlaintext(digest, result)) {
+        result.timings.conversionUs = conversionUs;
+        result.timings.inputBytes = bar.size();
+        return result;
+    }
+    // the buffer shares bar, there is no copy of the ciphertext
+    QBuffer buffer;
+    buffer.setData(bar);
+    buffer.open(QIODevice::ReadOnly);
+    ByteProgress progress(this, bar.size(), isOperationThread());
+    DeviceReader reader(&buffer, progress);
+    GpgME::Data encryptedString(&reader);
+    // the plaintext is decoded straight from GpgME's output buffers (see Utf8StringWriter)
+    result = decryptToString(encryptedString, fingerprint_, inputString_.size());
+    result.timings.conversionUs += conversionUs;
+    result.timings.inputBytes = bar.size();
+    if (!digest.isEmpty()) {
+        cachePlaintext(digest, result);
+    }
+    return result;
+}
+
+GPGOperationResult GPGMeWrapper::decryptDocument(const KTextEditor::Document *doc_, const QString &fingerprint_)
+{
+    DocumentReader reader(doc_);
+    GpgME::Data encryptedString(&reader);
+    GPGOperationResult result = decryptToString(encryptedString, fingerprint_, doc_->totalCharacters());
+    moveToConversionTime(result.timings, reader.conversionNsecs());
+    result.timings.inputBytes = reader.bytesRead();
+    return result;
+}
+
+GPGOperationResult GPGMeWrapper::decryptToString(const GpgME::Data &input_, const QString &fingerprint_, qsizetype sizeHint_)
+{
+    // the plaintext is decoded while GpgME writes it, there is no
+    // intermediate byte buffer holding the whole decrypted text
+    QString decryptedText;
+    decryptedText.reserve(sizeHint_);
+    Utf8StringWriter writer(decryptedText);
+    GpgME::Data decryptedString(&writer);
+    GPGOperationResult result = decryptData(input_, decryptedString, fingerprint_);
+    if (result.decryptionSuccess) {
+        writer.finish();
+        result.resultString = std::move(decryptedText);
+    }
+    moveToConversionTime(result.timings, writer.conversionNsecs());
+    result.timings.outputBytes = writer.bytesWritten();
+    return result;
+}
+
+GPGOperationResult GPGMeWrapper::decryptData(const GpgME::Data &input_, GpgME::Data &output_, const QString &fingerprint_)
 {
     GPGOperationResult result;
     GpgME::Error err;
-    GpgME::Protocol protocol = GpgME::OpenPGP;
     unsigned int mode = 0;
-    GpgME::initializeLibrary();
-    auto ctx = std::unique_ptr<GpgME::Context>(GpgME::Context::createForProtocol(protocol));
-    ctx->setArmor(true);
-    ctx->setTextMode(true);
+    QElapsedTimer timer;
+    timer.start();
+    auto ctx = m_contextPool.acquire(true, true);
+    if (!ctx) {
+        result.errorMessage.append(i18n("Error creating a GPG context"));
+        return result;
+    }
     ctx->setKeyListMode(mode);
-    // find correct key
-    const GpgME::Key key = ctx->key(fingerprint_.toUtf8().constData(), err, false);
+    OperationScope scope(this, ctx);
+    result.timings.contextSetupUs = timer.nsecsElapsed() / 1000;
+    // find correct key, without a fingerprint gpg picks the secret key from the message
+    timer.restart();
+    if (!fingerprint_.isEmpty()) {
+        findKey(ctx.get(), fingerprint_, false, err);
+    }
+    result.timings.keyLookupUs = timer.nsecsElapsed() / 1000;
     if (err) {
 #if GPGMEPP_VERSION_NUMBER < 12400 // use deprecated string conversion
         result.errorMessage.append(i18n("Error finding key: ") + QString::fromUtf8(err.asString()));
@@ -138,15 +766,15 @@ const GPGOperationResult GPGMeWrapper::decryptString(const QString &inputString_
     }
     result.keyFound = true;
 
-    const QString::size_type length = inputString_.size();
-    // To achieve non-volatile input for the GpgME++ decryption,
-    // we have to transform the encrypted text to a const char* buffer
-    // QString->toUtf8->constData()
-    QByteArray bar = inputString_.toUtf8();
-    GpgME::Data encryptedString(bar.constData(), length);
-    GpgME::Data decryptedString;
+    if (scope.isCancelled()) {
+        result.cancelled = true;
+        result.errorMessage.append(i18n("Operation cancelled"));
+        return result;
+    }
     // attempt to decrypt
-    GpgME::DecryptionResult d_res = ctx->decrypt(encryptedString, decryptedString);
+    timer.restart();
+    GpgME::DecryptionResult d_res = ctx->decrypt(input_, output_);
+    result.timings.cryptoUs = timer.nsecsElapsed() / 1000;
 #if GPGMEPP_VERSION_NUMBER < 20000
     if (!d_res.error()) {
 #else
@@ -159,64 +787,152 @@ const GPGOperationResult GPGMeWrapper::decryptString(const QString &inputString_
         }
 
     } else {
+        result.cancelled = d_res.error().isCanceled();
 #if GPGMEPP_VERSION_NUMBER < 12400 // use deprecated string conversion
         result.errorMessage.append(QString::fromUtf8(d_res.error().asString()));
 #else
-        result.errorMessage.append(d_res.error().asStdString());
+        result.errorMessage.append(QString::fromStdString(d_res.error().asStdString()));
 #endif
-        return result;
     }
-
-    result.resultString = QString::fromStdString(decryptedString.toString());
     return result;
 }
 
 GPGOperationResult GPGMeWrapper::encryptString(const QString &inputString_,
-                                               const QString &fingerprint_,
+                                               const QStringList &fingerprints_,
                                                const QString &recipientMail_,
                                                const bool useASCII,
                                                bool symmetricEncryption_,
                                                bool showOnlyPrivateKeys_)
+{
+    // The text is converted to UTF-8 in small slices while GpgME reads it,
+    // instead of a full copy (which GpgME::Data would copy once more).
+    StringReader reader(inputString_);
+    // the total has to be in the bytes the reader counts, not in UTF-16 code units
+    ByteProgress progress(this, utf8Length(inputString_), isOperationThread());
+    reader.setProgress(&progress);
+    GpgME::Data plainTextData(&reader);
+    GPGOperationResult result =
+        encryptToString(plainTextData, inputString_.size(), fingerprints_, recipientMail_, useASCII, symmetricEncryption_, showOnlyPrivateKeys_);
+    moveToConversionTime(result.timings, reader.conversionNsecs());
+    result.timings.inputBytes = reader.bytesRead();
+    return result;
+}
+
+GPGOperationResult GPGMeWrapper::encryptDocument(const KTextEditor::Document *doc_,
+                                                 const QStringList &fingerprints_,
+                                                 const QString &recipientMail_,
+                                                 const bool useASCII,
+                                                 bool symmetricEncryption_,
+                                                 bool showOnlyPrivateKeys_)
+{
+    DocumentReader reader(doc_);
+    GpgME::Data plainTextData(&reader);
+    GPGOperationResult result =
+        encryptToString(plainTextData, doc_->totalCharacters(), fingerprints_, recipientMail_, useASCII, symmetricEncryption_, showOnlyPrivateKeys_);
+    moveToConversionTime(result.timings, reader.conversionNsecs());
+    result.timings.inputBytes = reader.bytesRead();
+    return result;
+}
+
+GPGOperationResult GPGMeWrapper::encryptToString(const GpgME::Data &input_,
+                                                 qsizetype sizeHint_,
+                                                 const QStringList &fingerprints_,
+                                                 const QString &recipientMail_,
+                                                 const bool useASCII,
+                                                 bool symmetricEncryption_,
+                                                 bool showOnlyPrivateKeys_)
+{
+    // ASCII armor adds roughly a third to the plaintext size
+    QString armoredText;
+    armoredText.reserve(sizeHint_ + sizeHint_ / 3);
+    Utf8StringWriter writer(armoredText);
+    GpgME::Data ciphertext(&writer);
+    GPGOperationResult result = encryptData(input_, ciphertext, fingerprints_, recipientMail_, true, useASCII, symmetricEncryption_, showOnlyPrivateKeys_);
+    if (result.decryptionSuccess) {
+        writer.finish();
+        result.resultString = std::move(armoredText);
+    }
+    moveToConversionTime(result.timings, writer.conversionNsecs());
+    result.timings.outputBytes = writer.bytesWritten();
+    return result;
+}
+
+GPGOperationResult GPGMeWrapper::encryptData(const GpgME::Data &input_,
+                                             GpgME::Data &output_,
+                                             const QStringList &fingerprints_,
+                                             const QString &recipientMail_,
+                                             bool armor_,
+                                             bool textMode_,
+                                             bool symmetricEncryption_,
+                                             bool showOnlyPrivateKeys_,
+                                             bool compressedInput_)
 {
     GPGOperationResult result;
+    // the fingerprint identifies the key, the mail address is not needed to find it
+    Q_UNUSED(recipientMail_);
+    QElapsedTimer timer;
+    timer.start();
 
+    GpgME::Error err;
+    auto ctx = m_contextPool.acquire(armor_, textMode_);
+    if (!ctx) {
+        result.errorMessage.append(i18n("Error creating a GPG context"));
+        return result;
+    }
+    OperationScope scope(this, ctx);
+    result.timings.contextSetupUs = timer.nsecsElapsed() / 1000;
+
+    // All recipients get encrypted to in a single pass over the plaintext.
+    timer.restart();
     std::vector<GpgME::Key> selectedKeys;
-    std::vector<GpgME::Key> keys = listKeys(showOnlyPrivateKeys_, recipientMail_);
-    // find first key for selected fingerprint and mail address
-    for (auto &key : keys) {
-        const QString fingerprint = QString::fromUtf8(key.primaryFingerprint());
-        if (fingerprint == fingerprint_) {
-            result.keyFound = true;
-            selectedKeys.push_back(key);
-            break;
+    QStringList missingFingerprints;
+    QSet<QString> addedFingerprints;
+    for (const QString &fingerprint : fingerprints_) {
+        if (addedFingerprints.contains(fingerprint)) {
+            continue; // e.g. the own key was selected and added as "encrypt to self"
+        }
+        GpgME::Error keyErr;
+        const GpgME::Key key = findKey(ctx.get(), fingerprint, showOnlyPrivateKeys_, keyErr);
+        if (key.isNull()) {
+            missingFingerprints.append(fingerprint);
+            continue;
         }
+        addedFingerprints.insert(fingerprint);
+        selectedKeys.push_back(key);
     }
+    result.keyFound = !selectedKeys.empty() && missingFingerprints.isEmpty();
 
-    GpgME::Error err;
-    GpgME::Protocol protocol = GpgME::OpenPGP;
-    GpgME::initializeLibrary();
-    auto ctx = std::unique_ptr<GpgME::Context>(GpgME::Context::createForProtocol(protocol));
-    ctx->setArmor(true);
-    if (useASCII) {
-        ctx->setTextMode(true);
+    result.timings.keyLookupUs = timer.nsecsElapsed() / 1000;
+    if (!symmetricEncryption_ && !result.keyFound) {
+        // never encrypt to only a part of the recipients
+        if (!missingFingerprints.isEmpty()) {
+            result.errorMessage.append(i18n("No key found for: %1", missingFingerprints.join(QStringLiteral(", "))));
+        }
+        return result;
+    }
+    if (scope.isCancelled()) {
+        result.cancelled = true;
+        result.errorMessage.append(i18n("Operation cancelled"));
+        return result;
     }
-
-    QByteArray bar = inputString_.toUtf8();
-    const qsizetype length = bar.length();
-    GpgME::Data plainTextData = GpgME::Data(bar.constData(), length);
-    GpgME::Data ciphertext;
 
     // encrypt
     // Using EncryptionFlags::NoEncryptTo returns a NotImplemented error... so we
     // have to use AlwaysTrust :/
     GpgME::Context::EncryptionFlags flags = GpgME::Context::EncryptionFlags::AlwaysTrust;
+    const GPGCompression compression = m_compression;
+    if (compression == GPGCompression::None || (compression == GPGCompression::Auto && compressedInput_)) {
+        flags = static_cast<GpgME::Context::EncryptionFlags>(flags | GpgME::Context::EncryptionFlags::NoCompress);
+    }
+    timer.restart();
     if (symmetricEncryption_) {
-        err = ctx->encryptSymmetrically(plainTextData, ciphertext);
+        err = ctx->encryptSymmetrically(input_, output_);
+        result.timings.cryptoUs = timer.nsecsElapsed() / 1000;
         if (!err) {
             result.decryptionSuccess = true;
-            result.resultString = QString::fromStdString(ciphertext.toString());
             return result;
         } else {
+            result.cancelled = err.isCanceled();
 #if GPGMEPP_VERSION_NUMBER < 12400 // use deprecated string conversion
             result.errorMessage.append(i18n("Error in symmetric encryption: ") + QString::fromUtf8(err.asString()));
 #else
@@ -225,16 +941,17 @@ GPGOperationResult GPGMeWrapper::encryptString(const QString &inputString_,
             return result;
         }
     }
-    GpgME::EncryptionResult enRes = ctx->encrypt(selectedKeys, plainTextData, ciphertext, flags);
+    GpgME::EncryptionResult enRes = ctx->encrypt(selectedKeys, input_, output_, flags);
+    result.timings.cryptoUs = timer.nsecsElapsed() / 1000;
 #if GPGMEPP_VERSION_NUMBER < 20000
     if (!enRes.error()) {
 #else
     if (!enRes.error().isError()) {
 #endif
         result.decryptionSuccess = true;
-        result.resultString = QString::fromStdString(ciphertext.toString());
         return result;
     } else {
+        result.cancelled = enRes.error().isCanceled();
 #if GPGMEPP_VERSION_NUMBER < 12400 // use deprecated string conversion
         result.errorMessage.append(i18n("Encryption Failed: ") + QString::fromUtf8(enRes.error().asString()));
 #else
@@ -245,14 +962,364 @@ GPGOperationResult GPGMeWrapper::encryptString(const QString &inputString_,
     return result;
 }
 
-bool GPGMeWrapper::isEncrypted(const QString &inputString_)
+GPGOperationResult GPGMeWrapper::encryptFile(const QString &inputPath_,
+                                             const QString &outputPath_,
+                                             const QStringList &fingerprints_,
+                                             const QString &recipientMail_,
+                                             bool armor_,
+                                             bool symmetricEncryption_,
+                                             bool showOnlyPrivateKeys_)
+{
+    GPGOperationResult result;
+    QFile inputFile(inputPath_);
+    QSaveFile outputFile(outputPath_);
+    if (!openFilesForOperation(inputFile, outputFile, result)) {
+        return result;
+    }
+    // GpgME reads the file and writes the file descriptor in small blocks,
+    // the file content is never loaded as a whole
+    const bool compressedInput = isCompressedData(inputFile.peek(16));
+    ByteProgress progress(this, inputFile.size(), isOperationThread());
+    DeviceReader reader(&inputFile, progress);
+    GpgME::Data plainTextData(&reader);
+    GpgME::Data ciphertext(outputFile.handle());
+    result =
+        encryptData(plainTextData, ciphertext, fingerprints_, recipientMail_, armor_, false, symmetricEncryption_, showOnlyPrivateKeys_, compressedInput);
+    result.timings.inputBytes = inputFile.size();
+    finishFileOperation(outputFile, result);
+    return result;
+}
+
+GPGOperationResult GPGMeWrapper::decryptFile(const QString &inputPath_, const QString &outputPath_, const QString &fingerprint_)
+{
+    GPGOperationResult result;
+    QFile inputFile(inputPath_);
+    QSaveFile outputFile(outputPath_);
+    if (!openFilesForOperation(inputFile, outputFile, result)) {
+        return result;
+    }
+    ByteProgress progress(this, inputFile.size(), isOperationThread());
+    DeviceReader reader(&inputFile, progress);
+    GpgME::Data encryptedData(&reader);
+    GpgME::Data plainTextData(outputFile.handle());
+    result = decryptData(encryptedData, plainTextData, fingerprint_);
+    result.timings.inputBytes = inputFile.size();
+    finishFileOperation(outputFile, result);
+    return result;
+}
+
+GPGOperationResult GPGMeWrapper::decryptFileToString(const QString &path_, const QString &fingerprint_)
+{
+    GPGOperationResult result;
+    QFile inputFile(path_);
+    if (!inputFile.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        result.errorMessage.append(i18n("Cannot read %1: %2", path_, inputFile.errorString()));
+        return result;
+    }
+    QByteArray digest;
+    if (m_plaintextCacheEnabled) {
+        QElapsedTimer timer;
+        timer.start();
+        QCryptographicHash hash(QCryptographicHash::Sha256);
+        hash.addData(&inputFile);
+        digest = hash.result();
+        inputFile.seek(0);
+        if (findCachedPlaintext(digest, result)) {
+            result.timings.conversionUs = timer.nsecsElapsed() / 1000;
+            result.timings.inputBytes = inputFile.size();
+            return result;
+        }
+    }
+    ByteProgress progress(this, inputFile.size(), isOperationThread());
+    DeviceReader reader(&inputFile, progress);
+    GpgME::Data encryptedData(&reader);
+    // binary OpenPGP data is roughly the size of the plaintext
+    result = decryptToString(encryptedData, fingerprint_, inputFile.size());
+    result.timings.inputBytes = inputFile.size();
+    if (!digest.isEmpty()) {
+        cachePlaintext(digest, result);
+    }
+    return result;
+}
+
+bool GPGMeWrapper::decryptFileToStringAsync(const QString &path_, const QString &fingerprint_)
+{
+    return startOperation(
+        [this, path_, fingerprint_]() {
+            return decryptFileToString(path_, fingerprint_);
+        },
+        &GPGMeWrapper::decryptionFinished);
+}
+
+GPGOperationResult GPGMeWrapper::reencryptFile(const QString &path_, const QStringList &fingerprints_)
+{
+    GPGOperationResult result;
+    QFile inputFile(path_);
+    QSaveFile outputFile(path_);
+    if (!openFilesForOperation(inputFile, outputFile, result, true)) {
+        return result;
+    }
+    // keep the format of the file
+    const bool armor = inputFile.peek(64).trimmed().startsWith("-----BEGIN PGP MESSAGE-----");
+    GpgME::Data encryptedData(inputFile.handle());
+    // the plaintext only exists in this (locked, wiped) memory buffer
+    SecureMemoryData plainText;
+    GpgME::Data plainTextData(&plainText);
+    // the new recipients say nothing about the key the file is encrypted to
+    result = decryptData(encryptedData, plainTextData, QString());
+    if (result.decryptionSuccess) {
+        const GPGOperationTimings decryptionTimings = result.timings;
+        plainTextData.seek(0, SEEK_SET);
+        const bool compressedInput =
+            isCompressedData(QByteArray::fromRawData(plainText.data().constData(), qsizetype(qMin<size_t>(plainText.data().size(), 16))));
+        GpgME::Data ciphertext(outputFile.handle());
+        result = encryptData(plainTextData, ciphertext, fingerprints_, QString(), armor, false, false, false, compressedInput);
+        result.timings += decryptionTimings;
+    }
+    result.timings.inputBytes = inputFile.size();
+    finishFileOperation(outputFile, result);
+    return result;
+}
+
+bool GPGMeWrapper::reencryptFilesAsync(const QStringList &paths_, const QStringList &fingerprints_, int maxParallel_)
+{
+    return startOperation(
+        [=, this]() {
+            std::vector<GPGOperationResult> results(paths_.size());
+            std::atomic<int> numFinished(0);
+            // every job holds at most one plaintext, so at most maxParallel_ exist at once
+            runConcurrently(paths_.size(), maxParallel_, results, [&](int i) {
+                results[i] = reencryptFile(paths_.at(i), fingerprints_);
+                const int done = ++numFinished;
+                Q_EMIT batchFileFinished(paths_.at(i), results[i].decryptionSuccess ? QString() : results[i].errorMessage, done, paths_.size());
+            });
+            GPGOperationResult summary;
+            summary.keyFound = true;
+            summary.decryptionSuccess = true;
+            for (int i = 0; i < paths_.size(); ++i) {
+                mergeFileResult(summary, results[i], paths_.at(i));
+            }
+            return summary;
+        },
+        &GPGMeWrapper::fileOperationFinished);
+}
+
+bool GPGMeWrapper::openFilesForOperation(QFile &inputFile_, QSaveFile &outputFile_, GPGOperationResult &result_, bool replaceInput_)
+{
+    if (!inputFile_.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        result_.errorMessage.append(i18n("Cannot read %1: %2", inputFile_.fileName(), inputFile_.errorString()));
+        return false;
+    }
+    // never overwrite other existing files, this could silently destroy data
+    if (!replaceInput_ && QFileInfo::exists(outputFile_.fileName())) {
+        result_.errorMessage.append(i18n("%1 already exists", outputFile_.fileName()));
+        return false;
+    }
+    if (!outputFile_.open(QIODevice::WriteOnly | QIODevice::Unbuffered)) {
+        result_.errorMessage.append(i18n("Cannot write %1: %2", outputFile_.fileName(), outputFile_.errorString()));
+        return false;
+    }
+    return true;
+}
+
+void GPGMeWrapper::finishFileOperation(QSaveFile &outputFile_, GPGOperationResult &result_)
+{
+    // QSaveFile only replaces the target on commit(), a failed
+    // operation leaves no partial output behind
+    if (!result_.decryptionSuccess) {
+        outputFile_.cancelWriting();
+        return;
+    }
+    result_.timings.outputBytes = outputFile_.size();
+    if (!outputFile_.commit()) {
+        result_.decryptionSuccess = false;
+        result_.errorMessage.append(i18n("Cannot write %1: %2", outputFile_.fileName(), outputFile_.errorString()));
+        return;
+    }
+    result_.outputFiles.append(outputFile_.fileName());
+}
+
+bool GPGMeWrapper::encryptFilesAsync(const QStringList &inputPaths_,
+                                     const QStringList &fingerprints_,
+                                     const QString &recipientMail_,
+                                     bool armor_,
+                                     bool symmetricEncryption_,
+                                     bool showOnlyPrivateKeys_)
+{
+    return startOperation(
+        [=, this]() {
+            GPGOperationResult summary;
+            summary.keyFound = true;
+            summary.decryptionSuccess = true;
+            for (const QString &inputPath : inputPaths_) {
+                const QString outputPath = inputPath + (armor_ ? QStringLiteral(".asc") : QStringLiteral(".gpg"));
+                const GPGOperationResult res = encryptFile(inputPath, outputPath, fingerprints_, recipientMail_, armor_, symmetricEncryption_, showOnlyPrivateKeys_);
+                if (!mergeFileResult(summary, res, inputPath)) {
+                    break;
+                }
+            }
+            return summary;
+        },
+        &GPGMeWrapper::fileOperationFinished);
+}
+
+bool GPGMeWrapper::decryptFilesAsync(const QStringList &inputPaths_, const QString &fingerprint_)
+{
+    return startOperation(
+        [=, this]() {
+            GPGOperationResult summary;
+            summary.keyFound = true;
+            summary.decryptionSuccess = true;
+            for (const QString &inputPath : inputPaths_) {
+                const GPGOperationResult res = decryptFile(inputPath, decryptedFilePath(inputPath), fingerprint_);
+                if (!mergeFileResult(summary, res, inputPath)) {
+                    break;
+                }
+            }
+            return summary;
+        },
+        &GPGMeWrapper::fileOperationFinished);
+}
+
+bool GPGMeWrapper::mergeFileResult(GPGOperationResult &summary_, const GPGOperationResult &result_, const QString &inputPath_)
 {
-    QByteArray bar = inputString_.toUtf8();
+    summary_.outputFiles += result_.outputFiles;
+    summary_.timings += result_.timings;
+    if (result_.cancelled) {
+        summary_.cancelled = true;
+        summary_.decryptionSuccess = false;
+        return false;
+    }
+    if (!result_.decryptionSuccess) {
+        summary_.decryptionSuccess = false;
+        summary_.errorMessage.append(inputPath_ + QStringLiteral(": ") + result_.errorMessage + QLatin1Char('\n'));
+    }
+    return true;
+}
+
+QString GPGMeWrapper::decryptedFilePath(const QString &encryptedPath_)
+{
+    for (const QLatin1String suffix : {QLatin1String(".gpg"), QLatin1String(".asc"), QLatin1String(".pgp")}) {
+        if (encryptedPath_.endsWith(suffix, Qt::CaseInsensitive)) {
+            return encryptedPath_.chopped(suffix.size());
+        }
+    }
+    return encryptedPath_ + QStringLiteral(".decrypted");
+}
+
+/**
+ * @brief Checks for an ASCII armored message header and inspects the first
+ *        packet of the armored body. Only the first few lines are looked at.
+ */
+bool hasEncryptedArmorHeader(const QString &inputString_)
+{
+    const QLatin1String armorHeader("-----BEGIN PGP MESSAGE-----");
+    qsizetype pos = 0;
+    while (pos < inputString_.size() && inputString_.at(pos).isSpace()) {
+        ++pos;
+    }
+    if (!QStringView(inputString_).mid(pos).startsWith(armorHeader)) {
+        return false;
+    }
+    // skip the header line and the optional armor headers (Version:, Comment:, ...)
+    // up to the empty line that separates them from the base64 body
+    pos = inputString_.indexOf(QLatin1Char('\n'), pos);
+    bool bodyReached = false;
+    for (int lineCount = 0; pos >= 0 && lineCount < 32; ++lineCount) {
+        const qsizetype lineStart = pos + 1;
+        pos = inputString_.indexOf(QLatin1Char('\n'), lineStart);
+        const qsizetype lineEnd = pos < 0 ? inputString_.size() : pos;
+        const QStringView line = QStringView(inputString_).mid(lineStart, lineEnd - lineStart).trimmed();
+        if (!bodyReached) {
+            bodyReached = line.isEmpty();
+            continue;
+        }
+        // the first body line holds 48 bytes which is plenty for the packet header
+        return GPGMeWrapper::hasEncryptedPacketHeader(QByteArray::fromBase64(line.toLatin1()));
+    }
+    return false;
+}
+
+/**
+ * @brief Kate loads binary files with a single byte encoding at best,
+ *        so the first characters are mapped back to bytes for sniffing.
+ */
+bool hasEncryptedBinaryHeader(const QString &inputString_)
+{
+    QByteArray header;
+    for (qsizetype i = 0; i < inputString_.size() && i < 16; ++i) {
+        const char16_t c = inputString_.at(i).unicode();
+        if (c > 0xff) {
+            return false;
+        }
+        header.append(static_cast<char>(c));
+    }
+    return GPGMeWrapper::hasEncryptedPacketHeader(header);
+}
+
+bool GPGMeWrapper::hasEncryptedPacketHeader(const QByteArray &data_)
+{
+    // see RFC 4880/9580, section 4.2 (packet headers)
+    if (data_.size() < 3) {
+        return false;
+    }
+    const uchar ctb = static_cast<uchar>(data_.at(0));
+    if (!(ctb & 0x80)) {
+        return false;
+    }
+    int tag = 0;
+    qsizetype bodyOffset = 1;
+    if (ctb & 0x40) { // new packet format
+        tag = ctb & 0x3f;
+        const uchar lengthOctet = static_cast<uchar>(data_.at(1));
+        if (lengthOctet < 192) {
+            bodyOffset += 1;
+        } else if (lengthOctet < 224) {
+            bodyOffset += 2;
+        } else if (lengthOctet == 255) {
+            bodyOffset += 5;
+        } else {
+            bodyOffset += 1; // partial body length
+        }
+    } else { // old packet format
+        tag = (ctb >> 2) & 0x0f;
+        const int lengthType = ctb & 0x03;
+        bodyOffset += lengthType == 3 ? 0 : (1 << lengthType);
+    }
+    // The packet version is checked as well, otherwise any text starting
+    // with a non-ASCII UTF-8 sequence could pass as a packet header.
+    const int version = bodyOffset < data_.size() ? static_cast<uchar>(data_.at(bodyOffset)) : -1;
+    switch (tag) {
+    case 1: // public-key encrypted session key
+        return version == 3 || version == 6;
+    case 3: // symmetric-key encrypted session key
+        return version == 4 || version == 5 || version == 6;
+    case 9: // symmetrically encrypted data (legacy, no version field)
+        return true;
+    case 18: // symmetrically encrypted and integrity protected data
+        return version == 1 || version == 2;
+    case 20: // AEAD encrypted data
+        return version == 1;
+    default:
+        return false;
+    }
+}
+
+bool GPGMeWrapper::isEncrypted(const QString &inputString_, bool strictCheck_)
+{
+    if (!hasEncryptedArmorHeader(inputString_) && !hasEncryptedBinaryHeader(inputString_)) {
+        return false;
+    }
+    if (!strictCheck_) {
+        return true;
+    }
+    const QByteArray bar = inputString_.toUtf8();
     GpgME::Data dataIn(bar.constData(), (size_t)bar.size(),
                        false); // false = do not copy
-    QByteArray outBuffer;
-    GpgME::Data dataOut(outBuffer.constData(), outBuffer.size());
-    std::unique_ptr<GpgME::Context> ctx(GpgME::Context::createForProtocol(GpgME::OpenPGP));
+    // the plaintext is discarded, but it must not linger in memory either
+    SecureMemoryData plainText;
+    GpgME::Data dataOut(&plainText);
+    auto ctx = m_contextPool.acquire(false, false);
     if (!ctx) {
         return false;
     }
@@ -261,3 +1328,117 @@ bool GPGMeWrapper::isEncrypted(const QString &inputString_)
 
     return !result.error() && result.numRecipients() > 0;
 }
+
+bool GPGMeWrapper::isBinaryEncryptedFile(const QString &path_)
+{
+    QFile file(path_);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    return hasEncryptedPacketHeader(file.read(16));
+}
+
+/**
+ * @brief The CRC-24 of the ASCII armor checksum line, see RFC 4880, section 6.1
+ */
+quint32 armorChecksum(const QByteArray &data_)
+{
+    quint32 crc = 0xB704CE;
+    for (const char c : data_) {
+        crc ^= static_cast<quint32>(static_cast<uchar>(c)) << 16;
+        for (int i = 0; i < 8; ++i) {
+            crc <<= 1;
+            if (crc & 0x1000000) {
+                crc ^= 0x1864CFB;
+            }
+        }
+    }
+    return crc & 0xFFFFFF;
+}
+
+/**
+ * @brief Tests if armored_ is exactly one armored PGP message, i.e. there
+ *        is nothing but whitespace before its BEGIN and after its END line.
+ *        Anything else would be lost when the file is stored as packets.
+ */
+bool isSingleArmoredMessage(const QByteArray &armored_)
+{
+    static const QByteArray begin = QByteArrayLiteral("-----BEGIN PGP MESSAGE-----");
+    static const QByteArray end = QByteArrayLiteral("-----END PGP MESSAGE-----");
+    const QByteArray trimmed = armored_.trimmed();
+    return trimmed.startsWith(begin) && trimmed.endsWith(end) && trimmed.count(begin) == 1 && trimmed.count(end) == 1;
+}
+
+/**
+ * @brief Decodes the body of an ASCII armored message.
+ * @return The raw packets or an empty array if armored_ is no valid armored message.
+ */
+QByteArray dearmor(const QByteArray &armored_)
+{
+    const QList<QByteArray> lines = armored_.split('\n');
+    qsizetype i = 0;
+    while (i < lines.size() && lines.at(i).trimmed() != "-----BEGIN PGP MESSAGE-----") {
+        ++i;
+    }
+    // skip the armor headers (Version:, Comment:, ...) up to the empty line
+    do {
+        ++i;
+    } while (i < lines.size() && !lines.at(i).trimmed().isEmpty());
+    QByteArray body;
+    QByteArray checksum;
+    bool endReached = false;
+    while (++i < lines.size()) {
+        const QByteArray line = lines.at(i).trimmed();
+        if (line.startsWith("-----END PGP MESSAGE-----")) {
+            endReached = true;
+            break;
+        }
+        if (line.startsWith('=')) {
+            checksum = QByteArray::fromBase64(line.mid(1));
+        } else {
+            body += line;
+        }
+    }
+    if (!endReached) {
+        return QByteArray();
+    }
+    const QByteArray packets = QByteArray::fromBase64(body);
+    // the checksum is optional since RFC 9580
+    if (!checksum.isEmpty()) {
+        if (checksum.size() != 3) {
+            return QByteArray();
+        }
+        const quint32 expected = (static_cast<quint32>(static_cast<uchar>(checksum.at(0))) << 16)
+            | (static_cast<quint32>(static_cast<uchar>(checksum.at(1))) << 8) | static_cast<uchar>(checksum.at(2));
+        if (armorChecksum(packets) != expected) {
+            return QByteArray();
+        }
+    }
+    return packets;
+}
+
+bool GPGMeWrapper::dearmorFile(const QString &path_, QString &errorMessage_)
+{
+    QFile inputFile(path_);
+    if (!inputFile.open(QIODevice::ReadOnly)) {
+        errorMessage_ = i18n("Cannot read %1: %2", path_, inputFile.errorString());
+        return false;
+    }
+    const QByteArray armored = inputFile.readAll();
+    inputFile.close();
+    if (!isSingleArmoredMessage(armored)) {
+        errorMessage_ = i18n("%1 contains text besides the PGP message, converting it to binary would drop that text", path_);
+        return false;
+    }
+    const QByteArray packets = dearmor(armored);
+    if (!hasEncryptedPacketHeader(packets)) {
+        errorMessage_ = i18n("%1 does not contain a valid ASCII armored PGP message", path_);
+        return false;
+    }
+    QSaveFile outputFile(path_);
+    if (!outputFile.open(QIODevice::WriteOnly) || outputFile.write(packets) != packets.size() || !outputFile.commit()) {
+        errorMessage_ = i18n("Cannot write %1: %2", path_, outputFile.errorString());
+        return false;
+    }
+    return true;
+}
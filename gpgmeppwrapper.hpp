@@ -12,29 +12,116 @@
 
 #include <gpgme++/key.h>
 
+#include "gpgcontextpool.hpp"
 #include "gpgkeydetails.hpp"
+#include "plaintextcache.hpp"
 
+#include <QDateTime>
+#include <QHash>
+#include <QLoggingCategory>
+#include <QMetaType>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
 #include <QVector>
 #include <QVersionNumber>
 
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// forward declarations
+class QFile;
+class QFileSystemWatcher;
+class QSaveFile;
+class QThread;
+class QTimer;
+
+namespace GpgME
+{
+class Context;
+class Data;
+class Error;
+}
+
+namespace KTextEditor
+{
+class Document;
+}
+
+// Timing of all operations, enable with QT_LOGGING_RULES="kate.gpgplugin.timing.debug=true"
+Q_DECLARE_LOGGING_CATEGORY(KATE_GPG_TIMING)
+
+/**
+ * @brief Where the time of an operation went (in microseconds) and how
+ *        much data it processed. Phases an operation doesn't have stay 0.
+ */
+struct GPGOperationTimings {
+    qint64 keyLookupUs = 0; // finding the key(s) to use
+    qint64 contextSetupUs = 0; // getting a configured GpgME context
+    qint64 cryptoUs = 0; // gpg and gpg-agent, including passphrase prompts
+    qint64 conversionUs = 0; // QString <-> UTF-8
+    qint64 documentUpdateUs = 0; // replacing the document text, set by the plugin view
+    qint64 inputBytes = 0;
+    qint64 outputBytes = 0;
+
+    GPGOperationTimings &operator+=(const GPGOperationTimings &other_);
+    QString toString() const;
+};
+
 struct GPGOperationResult {
     QString resultString; // de- or encrypted string depending on operation
     bool keyFound = false;
     bool decryptionSuccess = false;
     QString errorMessage;
     QString keyIDUsedForDecryption;
+    bool cancelled = false; // true if the operation was aborted via cancelOperation()
+    QStringList outputFiles; // files written by the file based operations
+    GPGOperationTimings timings;
+    // one entry per input of decryptStringsAsync(), a null string if that input failed
+    QStringList resultStrings;
 };
 
-class GPGMeWrapper
+Q_DECLARE_METATYPE(GPGOperationResult)
+
+/**
+ * @brief Compression of the plaintext before encryption. GpgME has no
+ *        per operation choice of algorithm or level, those come from
+ *        gpg.conf (compress-algo, compress-level).
+ */
+enum class GPGCompression {
+    Default = 0, // as configured for gpg
+    None, // never compress (saves CPU time)
+    Auto // skip compression for input that is compressed already
+};
+
+class GPGMeWrapper : public QObject
 {
+    Q_OBJECT
+
 private:
     // The list of available GPG Keys
-    QVector<GPGKeyDetails> m_keys;
+    std::vector<GPGKeyDetails> m_keys;
 
     // for convenience reasons we want to know the currently selected key from the
     // UI
     uint m_selectedKeyIndex = 0;
 
+    // read by the worker threads of the operations
+    std::atomic<GPGCompression> m_compression{GPGCompression::Default};
+
+    // Decrypted texts of this session, only used if enabled
+    PlaintextCache m_plaintextCache;
+    std::atomic<bool> m_plaintextCacheEnabled{false};
+    // wipes expired plaintexts even if the cache is not accessed
+    QTimer *m_plaintextCacheTimer = nullptr;
+
+    // Fills result_ from the plaintext cache, false if the ciphertext is not cached
+    bool findCachedPlaintext(const QByteArray &digest_, GPGOperationResult &result_);
+    void cachePlaintext(const QByteArray &digest_, const GPGOperationResult &result_);
+
     /**
      * @brief Gets all available GPG keys containing mail addresses
      *        with search pattern.
@@ -43,8 +130,144 @@ private:
      */
     std::vector<GpgME::Key> listKeys(bool showOnlyPrivateKeys_, const QString &searchPattern_ = QLatin1String(""));
 
+    // In-memory copy of the whole keyring. It is filled on first use and
+    // only refreshed after the keyring files in the GPG home dir changed,
+    // loadKeys() filters this instead of asking gpg again.
+    std::vector<GpgME::Key> m_keyCache;
+    QSet<QByteArray> m_secretKeyFingerprints;
+    bool m_keyCacheValid = false;
+
+    // Watches pubring.kbx and private-keys-v1.d in the GPG home dir
+    QFileSystemWatcher *m_gpgHomeWatcher = nullptr;
+    // Coalesces the bursts of change events a key import causes
+    QTimer *m_keyringChangedTimer = nullptr;
+    QString m_gpgHomeDir;
+    // Modification times of the watched keyring files at the time the cache was filled
+    QDateTime m_publicKeyringTimestamp;
+    QDateTime m_privateKeysTimestamp;
+
+    // Fingerprint -> key lookup for the operations. It is never modified
+    // once built, a new cache replaces it as a whole, so the worker threads
+    // only need the mutex to copy the pointer.
+    struct FingerprintIndex {
+        QHash<QByteArray, GpgME::Key> keys;
+        QSet<QByteArray> secretKeyFingerprints;
+    };
+    std::shared_ptr<const FingerprintIndex> m_fingerprintIndex;
+    QMutex m_fingerprintIndexMutex;
+
+    /**
+     * @brief Looks up a key by fingerprint in the cache without starting
+     *        a key listing. Falls back to asking gpg via ctx_ for keys
+     *        that are not cached.
+     */
+    GpgME::Key findKey(GpgME::Context *ctx_, const QString &fingerprint_, bool secretOnly_, GpgME::Error &err_);
+
+    // Everything read from the keyring for the cache. This is filled in
+    // a worker thread and then handed to the GUI thread.
+    struct KeyringSnapshot {
+        std::vector<GpgME::Key> keys;
+        QSet<QByteArray> secretKeyFingerprints;
+        std::shared_ptr<const FingerprintIndex> fingerprintIndex;
+        QDateTime publicKeyringTimestamp;
+        QDateTime privateKeysTimestamp;
+    };
+    KeyringSnapshot readKeyring(const QString &gpgHomeDir_);
+    void installKeyCache(KeyringSnapshot &&snapshot_);
+    void refreshKeyCache();
+
+    // The worker thread of loadKeyCacheAsync()
+    QThread *m_keyLoadThread = nullptr;
+    bool m_keyCacheReloadPending = false;
+
+    void watchGPGHomeDir();
+    void onGPGHomeDirChanged();
+    bool matchesSearchPattern(const GpgME::Key &key_, const QString &searchPattern_) const;
+
+    // Preconfigured contexts shared by all operations
+    GPGContextPool m_contextPool;
+
+    // The worker thread of the currently running asynchronous operation
+    QThread *m_operationThread = nullptr;
+
+    // true if called from m_operationThread, only that thread reports progress
+    bool isOperationThread() const;
+
+    // Guards the contexts of the running asynchronous operation and the
+    // cancellation flag, both are accessed from the GUI and the worker threads.
+    QMutex m_operationMutex;
+    QSet<GpgME::Context *> m_activeContexts;
+    bool m_cancelRequested = false;
+
+    // Registers a context as the running asynchronous operation (see .cpp)
+    class OperationScope;
+
+    /**
+     * @brief Runs job_ in a worker thread and emits finishedSignal_
+     *        with its result in the thread owning this object.
+     * @return false if another asynchronous operation is still running.
+     */
+    bool startOperation(const std::function<GPGOperationResult()> &job_, void (GPGMeWrapper::*finishedSignal_)(const GPGOperationResult &));
+
+    /**
+     * @brief Runs job_(0) ... job_(count_ - 1) on at most maxThreads_ pool
+     *        threads and waits for all of them. Must be called from the
+     *        operation thread, the contexts of the jobs can be cancelled.
+     *        Each job stores its outcome in results_[i], jobs that did not
+     *        start before a cancel request are left marked as cancelled.
+     */
+    void runConcurrently(int count_, int maxThreads_, std::vector<GPGOperationResult> &results_, const std::function<void(int)> &job_);
+
+    /**
+     * @brief Shared implementation of all decrypt functions below.
+     *        Writes the plaintext to output_.
+     */
+    GPGOperationResult decryptData(const GpgME::Data &input_, GpgME::Data &output_, const QString &fingerprint_);
+
+    /**
+     * @brief Decrypts input_ and decodes the plaintext into the result
+     *        string while GpgME produces it.
+     * @param sizeHint_ Expected size of the output in characters
+     */
+    GPGOperationResult decryptToString(const GpgME::Data &input_, const QString &fingerprint_, qsizetype sizeHint_);
+
+    /**
+     * @brief Shared implementation of all encrypt functions below.
+     *        Writes the ciphertext to output_.
+     * @param compressedInput_ input_ is compressed already (see GPGCompression::Auto)
+     */
+    GPGOperationResult encryptData(const GpgME::Data &input_,
+                                   GpgME::Data &output_,
+                                   const QStringList &fingerprints_,
+                                   const QString &recipientMail_,
+                                   bool armor_,
+                                   bool textMode_,
+                                   bool symmetricEncryption_,
+                                   bool showOnlyPrivateKeys_,
+                                   bool compressedInput_ = false);
+
+    /**
+     * @brief Encrypts input_ to ASCII armored text in the result string.
+     * @param sizeHint_ Expected size of the plaintext in characters
+     */
+    GPGOperationResult encryptToString(const GpgME::Data &input_,
+                                       qsizetype sizeHint_,
+                                       const QStringList &fingerprints_,
+                                       const QString &recipientMail_,
+                                       const bool useASCII,
+                                       bool symmetricEncryption_,
+                                       bool showOnlyPrivateKeys_);
+
+    // helpers for the file based operations
+    // replaceInput_: the output replaces the input file (only once the operation succeeded)
+    bool openFilesForOperation(QFile &inputFile_, QSaveFile &outputFile_, GPGOperationResult &result_, bool replaceInput_ = false);
+    // decrypts a file into memory and encrypts it back to the same file
+    GPGOperationResult reencryptFile(const QString &path_, const QStringList &fingerprints_);
+    void finishFileOperation(QSaveFile &outputFile_, GPGOperationResult &result_);
+    static bool mergeFileResult(GPGOperationResult &summary_, const GPGOperationResult &result_, const QString &inputPath_);
+
 public:
-    GPGMeWrapper();
+    explicit GPGMeWrapper(QObject *parent_ = nullptr);
 
     ~GPGMeWrapper();
 
@@ -52,7 +275,13 @@ public:
      * @brief Gets the list of available GPG keys.
      * @return The list of available GPG keys.
      */
-    const QVector<GPGKeyDetails> &getKeys() const;
+    const std::vector<GPGKeyDetails> &getKeys() const;
+
+    /**
+     * @brief Moves the keys of the last loadKeys() out of the wrapper,
+     *        getKeys() is empty afterwards.
+     */
+    std::vector<GPGKeyDetails> takeKeys();
 
     uint getNumKeys() const;
 
@@ -62,6 +291,28 @@ public:
      */
     void loadKeys(bool showOnlyPrivateKeys_, bool hideExpiredKeys_, const QString searchPattern_);
 
+    /**
+     * @brief Drops the in-memory keyring copy, the next loadKeys()
+     *        will read all keys from gpg again.
+     */
+    void invalidateKeyCache();
+
+    /**
+     * @brief Reads the keyring into the key cache in a worker thread and
+     *        emits keysChanged() when done. Until then loadKeys() keeps
+     *        using the previous cache (or yields no keys at startup).
+     */
+    void loadKeyCacheAsync();
+
+    bool isLoadingKeys() const;
+
+    /**
+     * @brief The fingerprint of the key used for "encrypt to self": like gpg
+     *        without a default-key option this is the first usable key
+     *        with a secret key. Empty if there is none (or no keys loaded yet).
+     */
+    QString defaultSecretKeyFingerprint() const;
+
     /**
      * @brief This function attempts to decrypt a given input string
      *        using any of the available private keys. Will fail if the
@@ -79,9 +330,10 @@ public:
      *        using the currently selected private key. Will fail if
      *        no fingerprint is selected in the ey table.
      * @param inputString_    The input string to be encrypted.
-     * @param fingerprint_    The selected fingerprint/key.
-     * @param recipientMail_ A recipent mail address matched with the
-     *        fingerprint.
+     * @param fingerprints_   The fingerprints of all recipients. The text is
+     *        encrypted to all of them at once, it fails if any key is missing.
+     * @param recipientMail_ The recipent mail address selected for the
+     *        fingerprint (informational, keys are found by fingerprint).
      * @param symmetricEncryption_ A bool to enable symmetric encryption
      *        (will ask for a symmetric passphrase that must be remembered).
      *        Default is false.
@@ -90,22 +342,244 @@ public:
      * @return The GPGOerationsResult (see above)
      */
     GPGOperationResult encryptString(const QString &inputString_,
-                                     const QString &fingerprint_,
+                                     const QStringList &fingerprints_,
                                      const QString &recipientMail_,
                                      const bool useASCII,
                                      bool symmetricEncryption_ = false,
                                      bool showOnlyPrivateKeys_ = false);
 
+    /**
+     * @brief Same as decryptString() but the ciphertext is streamed line by
+     *        line out of the document instead of being copied as a whole.
+     *        Must be called from the thread owning the document.
+     */
+    GPGOperationResult decryptDocument(const KTextEditor::Document *doc_, const QString &fingerprint_);
+
+    /**
+     * @brief Same as encryptString() but the plaintext is streamed line by
+     *        line out of the document through a fixed size buffer.
+     *        Must be called from the thread owning the document.
+     */
+    GPGOperationResult encryptDocument(const KTextEditor::Document *doc_,
+                                       const QStringList &fingerprints_,
+                                       const QString &recipientMail_,
+                                       const bool useASCII,
+                                       bool symmetricEncryption_ = false,
+                                       bool showOnlyPrivateKeys_ = false);
+
+    /**
+     * @brief Encrypts a file on disk without loading it into memory.
+     *        GpgME reads and writes the file descriptors directly.
+     *        An existing output file is never overwritten and the output
+     *        only appears once the operation succeeded.
+     * @param armor_ Write ASCII armored (.asc) instead of binary (.gpg) output.
+     */
+    GPGOperationResult encryptFile(const QString &inputPath_,
+                                   const QString &outputPath_,
+                                   const QStringList &fingerprints_,
+                                   const QString &recipientMail_,
+                                   bool armor_,
+                                   bool symmetricEncryption_ = false,
+                                   bool showOnlyPrivateKeys_ = false);
+
+    /**
+     * @brief Decrypts a file on disk without loading it into memory.
+     *        See encryptFile().
+     */
+    GPGOperationResult decryptFile(const QString &inputPath_, const QString &outputPath_, const QString &fingerprint_);
+
+    /**
+     * @brief Encrypts the given files one after another in a worker thread,
+     *        each to "<file>.gpg" resp. "<file>.asc". The summary is
+     *        delivered via fileOperationFinished().
+     * @return false if another asynchronous operation is still running.
+     */
+    bool encryptFilesAsync(const QStringList &inputPaths_,
+                           const QStringList &fingerprints_,
+                           const QString &recipientMail_,
+                           bool armor_,
+                           bool symmetricEncryption_ = false,
+                           bool showOnlyPrivateKeys_ = false);
+
+    /**
+     * @brief Decrypts the given files one after another in a worker thread,
+     *        see decryptedFilePath() for the output names.
+     * @return false if another asynchronous operation is still running.
+     */
+    bool decryptFilesAsync(const QStringList &inputPaths_, const QString &fingerprint_);
+
+    /**
+     * @brief Re-encrypts encrypted files in place to new recipients (key
+     *        rotation): each file is decrypted into memory and encrypted
+     *        to fingerprints_, keeping its armored/binary format. Up to
+     *        maxParallel_ files are processed at once, which also bounds the
+     *        number of plaintexts held in memory. A file is only replaced
+     *        once its new ciphertext is complete. Each file is reported via
+     *        batchFileFinished(), the summary via fileOperationFinished().
+     * @return false if another asynchronous operation is still running.
+     */
+    bool reencryptFilesAsync(const QStringList &paths_, const QStringList &fingerprints_, int maxParallel_);
+
+    /**
+     * @brief The output path used for decrypting a file: the .gpg/.asc/.pgp
+     *        extension is removed, otherwise ".decrypted" is appended.
+     */
+    static QString decryptedFilePath(const QString &encryptedPath_);
+
     /**
      * @brief To test if a given QString is GPG encrypted already.
-     * @param inputString_ The text to be tested
+     *        By default only the ASCII armor header resp. the first OpenPGP
+     *        packet is inspected, which neither needs gpg-agent nor
+     *        depends on the size of the text.
+     * @param inputString_ The text to be tested. The first lines are
+     *        enough for the default check, the strict check needs the
+     *        complete message (a truncated one always fails to decrypt).
+     * @param strictCheck_ Additionally attempt a full decryption.
+     *        This may ask for a passphrase!
      * @return true if the inputString_ has sufficient indicators for being
-     *         encrypted (by testing file extension and decryption success).
+     *         encrypted (and decryption succeeded for the strict check).
+     */
+    bool isEncrypted(const QString &inputString_, bool strictCheck_ = false);
+
+    /**
+     * @brief Tests if raw (binary) data starts with an OpenPGP packet
+     *        that begins an encrypted message (PKESK, SKESK, SED,
+     *        SEIPD or AEAD packet).
+     * @param data_ At least the first few bytes of the data.
+     */
+    static bool hasEncryptedPacketHeader(const QByteArray &data_);
+
+    /**
+     * @brief Tests if a file on disk is a binary (non-armored) OpenPGP
+     *        message. Kate cannot load those as text without mangling
+     *        them, see decryptFileToString().
+     */
+    static bool isBinaryEncryptedFile(const QString &path_);
+
+    /**
+     * @brief Decrypts a file on disk into the result string. GpgME reads the
+     *        raw bytes from the file descriptor, this works for binary and
+     *        ASCII armored files alike.
      */
-    bool isEncrypted(const QString &inputString_);
+    GPGOperationResult decryptFileToString(const QString &path_, const QString &fingerprint_);
 
-    bool isPreferredKey(const GPGKeyDetails d_, const QString &mailAddress_);
+    /**
+     * @brief Non-blocking variant of decryptFileToString(), the result is
+     *        delivered via decryptionFinished().
+     * @return false if another asynchronous operation is still running.
+     */
+    bool decryptFileToStringAsync(const QString &path_, const QString &fingerprint_);
+
+    /**
+     * @brief Replaces an ASCII armored message on disk with its raw OpenPGP
+     *        packets (like gpg --dearmor). No decryption is involved, the
+     *        armor checksum is verified and the file is replaced atomically.
+     *        Files with anything but whitespace around the one message
+     *        are refused, that content would be lost.
+     * @return false if the file could not be converted (errorMessage_ tells why),
+     *         the file is left untouched then.
+     */
+    static bool dearmorFile(const QString &path_, QString &errorMessage_);
+
+    /**
+     * @brief Non-blocking variant of decryptString(). The work is done in a
+     *        worker thread, the result is delivered via decryptionFinished().
+     * @return false if another asynchronous operation is still running.
+     */
+    bool decryptStringAsync(const QString &inputString_, const QString &fingerprint_);
+
+    /**
+     * @brief Non-blocking variant of encryptString(). The work is done in a
+     *        worker thread, the result is delivered via encryptionFinished().
+     * @return false if another asynchronous operation is still running.
+     */
+    bool encryptStringAsync(const QString &inputString_,
+                            const QStringList &fingerprints_,
+                            const QString &recipientMail_,
+                            const bool useASCII,
+                            bool symmetricEncryption_ = false,
+                            bool showOnlyPrivateKeys_ = false);
+
+    /**
+     * @brief Decrypts independent ciphertexts (e.g. the inline PGP blocks
+     *        of a document) concurrently on all cores, each job with its
+     *        own context. The results are delivered together via
+     *        decryptionOfStringsFinished() in result.resultStrings.
+     * @return false if another asynchronous operation is still running.
+     */
+    bool decryptStringsAsync(const QStringList &inputStrings_, const QString &fingerprint_);
+
+    /**
+     * @brief Aborts the running asynchronous operation (if any). The
+     *        finished signal is still emitted with result.cancelled set.
+     */
+    void cancelOperation();
+
+    bool isOperationRunning() const;
+
+    bool isPreferredKey(const GPGKeyDetails &d_, const QString &mailAddress_);
 
     void setSelectedKeyIndex(uint newSelectedKeyIndex);
     uint selectedKeyIndex() const;
+
+    /**
+     * @brief The compression used by all following encryptions. Symmetric
+     *        encryption always uses the gpg defaults.
+     */
+    void setCompression(GPGCompression compression_);
+    GPGCompression compression() const;
+
+    /**
+     * @brief Tests if data_ starts with the signature of a compressed
+     *        format (gzip, bzip2, xz, zstd, zip, 7z, JPEG, PNG, ...),
+     *        compressing those again only costs time.
+     * @param data_ At least the first 8 bytes of the data.
+     */
+    static bool isCompressedData(const QByteArray &data_);
+
+    /**
+     * @brief Enables the in-memory cache of decrypted texts: decrypting
+     *        the same ciphertext again (e.g. reopening an unchanged file)
+     *        returns the cached plaintext without asking gpg. Plaintexts
+     *        are wiped after timeToLiveSeconds_, disabling the cache wipes
+     *        them right away.
+     */
+    void setPlaintextCacheEnabled(bool enabled_, int timeToLiveSeconds_);
+
+    // wipes all cached plaintexts
+    void clearPlaintextCache();
+
+Q_SIGNALS:
+    /**
+     * @brief Emitted when the key cache got (re)filled in the background,
+     *        i.e. after loadKeyCacheAsync() and whenever the keyring in the
+     *        GPG home dir was modified (e.g. a key got imported).
+     *        Call loadKeys() to update getKeys().
+     */
+    void keysChanged();
+
+    void decryptionFinished(const GPGOperationResult &result_);
+    void encryptionFinished(const GPGOperationResult &result_);
+    void fileOperationFinished(const GPGOperationResult &result_);
+    void decryptionOfStringsFinished(const GPGOperationResult &result_);
+
+    /**
+     * @brief Emitted (from a worker thread) for every file of
+     *        reencryptFilesAsync(). errorMessage_ is empty on success.
+     */
+    void batchFileFinished(const QString &path_, const QString &errorMessage_, int done_, int total_);
+
+    /**
+     * @brief Forwarded from GpgME's progress callback (emitted from the
+     *        worker thread). total_ is 0 if the amount of work is unknown.
+     */
+    void operationProgress(const QString &what_, int current_, int total_);
+
+    /**
+     * @brief Emitted (from the worker thread) while GpgME reads the input
+     *        of an asynchronous single operation, at most every 100 ms and
+     *        once at the end of the input. bytesPerSecond_ is the average
+     *        rate since the operation started reading.
+     */
+    void operationThroughput(qint64 processedBytes_, qint64 totalBytes_, double bytesPerSecond_);
 };
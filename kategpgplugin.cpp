@@ -2,19 +2,39 @@
     SPDX-FileCopyrightText: 2025 Dennis Lübke <kde@dennis2society.de>
     SPDX-License-Identifier: LGPL-2.0-or-later
 */
+#include <KFormat>
 #include <KLocalizedString>
 #include <KPluginFactory>
 #include <KSharedConfig>
 #include <KTextEditor/Application>
 #include <KTextEditor/Editor>
 #include <KTextEditor/MainWindow>
+#include <QCryptographicHash>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFileDialog>
+#include <QHBoxLayout>
+#include <QInputDialog>
 #include <QLayout>
 #include <QMessageBox>
 #include <QScrollArea>
 #include <QScrollBar>
-#include <QTableWidgetItem>
+#include <QSpinBox>
+#include <QThread>
+#include <QTimer>
+#if QT_VERSION_MAJOR < 6
+#include <KTextEditor/ModificationInterface>
+#endif
+#ifdef HAVE_QTDBUS
+#include <QDBusConnection>
+#endif
+
+#include <QHeaderView>
+
+#include <utility>
 
 #include "gpgkeydetails.hpp"
+#include "gpgkeytablemodel.hpp"
 #include "kategpgplugin.hpp"
 
 K_PLUGIN_FACTORY_WITH_JSON(KateGPGPluginFactory, "kategpgplugin.json", registerPlugin<KateGPGPlugin>();)
@@ -35,18 +55,34 @@ void KateGPGPluginView::readPluginConfig()
 
     uint comboIndex = m_group.readEntry("selected_mail_address_index", 0);
     m_saveAsASCIICheckbox->setChecked(m_group.readEntry("use_ASCII_armor", true));
+    m_binaryGpgFilesCheckbox->setChecked(m_group.readEntry("binary_gpg_files", false));
+    m_compressionComboBox->setCurrentIndex(qBound(0, m_group.readEntry("compression", 0), m_compressionComboBox->count() - 1));
+    m_gpgWrapper->setCompression(static_cast<GPGCompression>(m_compressionComboBox->currentIndex()));
+    m_plaintextCacheMinutesSpinBox->setValue(m_group.readEntry("plaintext_cache_minutes", 10));
+    m_plaintextCacheCheckbox->setChecked(m_group.readEntry("plaintext_cache", false));
+    updatePlaintextCache();
     m_symmetricEncryptioCheckbox->setChecked(m_group.readEntry("use_symmetric_encryption", false));
     m_showOnlyPrivateKeysCheckbox->setChecked(m_group.readEntry("show_only_private_keys", true));
     m_hideExpiredKeysCheckbox->setChecked(m_group.readEntry("hide_expired_secret_keys", true));
+    m_showTimingsCheckbox->setChecked(m_group.readEntry("show_operation_timings", false));
+    m_encryptToSelfCheckbox->setChecked(m_group.readEntry("encrypt_to_self", false));
+    m_inlineBlocksCheckbox->setChecked(m_group.readEntry("inline_blocks_only", false));
+    updateRecipientGroupComboBox();
     m_preferredEmailLineEdit->setText(m_group.readEntry("search_string", ""));
+    // filter right away, the stored row index refers to the filtered table
+    m_searchDebounceTimer->stop();
+    onPreferredEmailAddressChanged();
     m_selectedRowIndex = m_group.readEntry("selected_key_index", 0);
-    if (m_gpgKeyTable->rowCount() > 0) {
+    if (m_keyProxyModel->rowCount() > 0) {
         m_gpgKeyTable->selectRow(m_selectedRowIndex);
     }
     uint numpreferredEmailAddressComboBoxCount = m_preferredEmailAddressComboBox->count();
     if (comboIndex <= numpreferredEmailAddressComboBoxCount) {
         m_preferredEmailAddressComboBox->setCurrentIndex(m_group.readEntry("selected_mail_address_index", 0));
     }
+    if (m_gpgWrapper->isLoadingKeys()) {
+        m_restoredMailAddressIndex = comboIndex;
+    }
 }
 
 void KateGPGPluginView::savePluginConfig()
@@ -55,16 +91,23 @@ void KateGPGPluginView::savePluginConfig()
     m_group.writeEntry("selected_key_index", m_selectedRowIndex);
     m_group.writeEntry("selected_mail_address_index", m_preferredEmailAddressComboBox->currentIndex());
     m_group.writeEntry("use_ASCII_armor", m_saveAsASCIICheckbox->isChecked());
+    m_group.writeEntry("binary_gpg_files", m_binaryGpgFilesCheckbox->isChecked());
+    m_group.writeEntry("compression", m_compressionComboBox->currentIndex());
+    m_group.writeEntry("plaintext_cache", m_plaintextCacheCheckbox->isChecked());
+    m_group.writeEntry("plaintext_cache_minutes", m_plaintextCacheMinutesSpinBox->value());
     m_group.writeEntry("use_symmetric_encryption", m_symmetricEncryptioCheckbox->isChecked());
     m_group.writeEntry("show_only_private_keys", m_showOnlyPrivateKeysCheckbox->isChecked());
     m_group.writeEntry("hide_expired_secret_keys", m_hideExpiredKeysCheckbox->isChecked());
+    m_group.writeEntry("show_operation_timings", m_showTimingsCheckbox->isChecked());
+    m_group.writeEntry("encrypt_to_self", m_encryptToSelfCheckbox->isChecked());
+    m_group.writeEntry("inline_blocks_only", m_inlineBlocksCheckbox->isChecked());
     m_group.sync();
 }
 
 KateGPGPluginView::KateGPGPluginView(KateGPGPlugin *plugin, KTextEditor::MainWindow *mainwindow)
     : m_mainWindow(mainwindow)
 {
-    m_gpgWrapper = new GPGMeWrapper();
+    m_gpgWrapper = new GPGMeWrapper(this);
     m_toolview.reset(m_mainWindow->createToolView(plugin, // pointer to plugin
                                                   QStringLiteral("gpgPlugin"), // just an identifier for the toolview
                                                   KTextEditor::MainWindow::Left, // we want to create a toolview on the
@@ -77,6 +120,38 @@ KateGPGPluginView::KateGPGPluginView(KateGPGPlugin *plugin, KTextEditor::MainWin
     // BUTTONS!
     m_gpgDecryptButton = new QPushButton(i18n("GPG Decrypt current document"));
     m_gpgEncryptButton = new QPushButton(i18n("GPG Encrypt current document"));
+    m_gpgDecryptBlocksButton = new QPushButton(i18n("GPG Decrypt all PGP blocks in document"));
+    m_gpgDecryptBlocksButton->setToolTip(
+        i18n("Decrypts every -----BEGIN PGP MESSAGE----- block in the current document\n"
+             "in parallel and replaces them in one step (a single undo)."));
+    m_gpgEncryptFilesButton = new QPushButton(i18n("GPG Encrypt files on disk..."));
+    m_gpgDecryptFilesButton = new QPushButton(i18n("GPG Decrypt files on disk..."));
+    m_gpgEncryptFilesButton->setToolTip(
+        i18n("Encrypts files directly on disk without opening them.\n"
+             "Each file is written to <file>.asc or <file>.gpg next to it\n"
+             "depending on the ASCII setting."));
+    m_gpgDecryptFilesButton->setToolTip(
+        i18n("Decrypts files directly on disk without opening them.\n"
+             "The output is written next to each file without its .gpg/.asc extension."));
+    m_gpgReencryptFilesButton = new QPushButton(i18n("GPG Re-encrypt files to selected keys..."));
+    m_gpgReencryptFilesButton->setToolTip(
+        i18n("Decrypts all encrypted open documents or all .gpg/.asc/.pgp files of a\n"
+             "directory tree and encrypts them in place to the selected keys\n"
+             "(e.g. after rotating a key). Several files are processed in parallel."));
+    m_operationButtons =
+        {m_gpgDecryptButton, m_gpgEncryptButton, m_gpgDecryptBlocksButton, m_gpgDecryptFilesButton, m_gpgEncryptFilesButton, m_gpgReencryptFilesButton};
+    m_gpgCancelButton = new QPushButton(i18n("Cancel running GPG operation"));
+    m_gpgCancelButton->setEnabled(false);
+    m_operationProgressBar = new QProgressBar();
+    m_operationProgressBar->setRange(0, 1);
+    m_operationProgressBar->setValue(0);
+    m_operationProgressBar->setTextVisible(false);
+    m_showTimingsCheckbox = new QCheckBox(i18n("Show timing of the last operation"));
+    m_showTimingsCheckbox->setChecked(false);
+    m_operationTimingLabel = new QLabel();
+    m_operationTimingLabel->setWordWrap(true);
+    m_operationTimingLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    m_operationTimingLabel->setVisible(false);
 
     // Lots of initialization and setting parameters for Qt UI stuff
     m_verticalLayout = new QVBoxLayout(m_toolview.get());
@@ -107,17 +182,86 @@ KateGPGPluginView::KateGPGPluginView(KateGPGPlugin *plugin, KTextEditor::MainWin
     m_saveAsASCIICheckbox = new QCheckBox(i18n("Save as ASCII encoded (.asc/.gpg)"));
     m_saveAsASCIICheckbox->setChecked(true);
 
+    m_binaryGpgFilesCheckbox = new QCheckBox(i18n("Save .gpg files in binary OpenPGP format"));
+    m_binaryGpgFilesCheckbox->setToolTip(
+        i18n("Stores .gpg files as raw OpenPGP packets like gpg does (about 25% smaller).\n"
+             ".asc files always stay ASCII armored."));
+    m_binaryGpgFilesCheckbox->setChecked(false);
+
+    m_compressionLabel = new QLabel(i18n("Compression before encryption:"));
+    m_compressionComboBox = new QComboBox();
+    // the item order matches GPGCompression
+    m_compressionComboBox->addItems({i18n("GPG default (see gpg.conf)"), i18n("None (fastest)"), i18n("Automatic (skip already compressed files)")});
+    m_compressionComboBox->setToolTip(
+        i18n("Logs and other text compress well, compressing archives, images\n"
+             "or media files again only costs time. Algorithm and level are\n"
+             "taken from compress-algo/compress-level in gpg.conf."));
+
+    m_plaintextCacheCheckbox = new QCheckBox(i18n("Remember decrypted texts in memory (minutes):"));
+    m_plaintextCacheCheckbox->setToolTip(
+        i18n("Reopening an unchanged encrypted file then needs no passphrase and no gpg call.\n"
+             "The texts are kept in locked memory, only for this Kate session, and are\n"
+             "wiped after the given time, when the screen gets locked or with the button."));
+    m_plaintextCacheCheckbox->setChecked(false);
+    m_plaintextCacheMinutesSpinBox = new QSpinBox();
+    m_plaintextCacheMinutesSpinBox->setRange(1, 24 * 60);
+    m_plaintextCacheMinutesSpinBox->setValue(10);
+    m_clearPlaintextCacheButton = new QPushButton(i18n("Wipe remembered texts"));
+
     m_symmetricEncryptioCheckbox = new QCheckBox(i18n("Enable symmetric encryption"));
     m_symmetricEncryptioCheckbox->setChecked(false);
 
+    m_inlineBlocksCheckbox = new QCheckBox(i18n("Only de-/encrypt the selection or the PGP block at the cursor"));
+    m_inlineBlocksCheckbox->setToolTip(
+        i18n("For text files with inline PGP messages: the buttons only work on the\n"
+             "selected text resp. the -----BEGIN PGP MESSAGE----- block around the cursor,\n"
+             "the rest of the document is left untouched. Saving still encrypts the whole file."));
+    m_inlineBlocksCheckbox->setChecked(false);
+
     m_showOnlyPrivateKeysCheckbox = new QCheckBox(i18n("Show only keys for which a private key is available"));
     m_showOnlyPrivateKeysCheckbox->setChecked(false);
 
     m_hideExpiredKeysCheckbox = new QCheckBox(i18n("Hide Expired Keys"));
     m_hideExpiredKeysCheckbox->setChecked(true);
 
-    m_gpgKeyTable = new QTableWidget(m_gpgWrapper->getNumKeys(), 5, m_toolview.get());
+    m_encryptToSelfCheckbox = new QCheckBox(i18n("Also encrypt to my own key"));
+    m_encryptToSelfCheckbox->setToolTip(
+        i18n("Adds your own (first usable private) key as recipient,\n"
+             "so you can still decrypt texts you encrypted to others."));
+    m_encryptToSelfCheckbox->setChecked(false);
+    m_recipientCountLabel = new QLabel();
+    m_recipientCountLabel->setVisible(false);
+    m_recipientGroupComboBox = new QComboBox();
+    m_recipientGroupComboBox->setToolTip(i18n("Selects all keys of a saved recipient group in the table."));
+    m_saveRecipientGroupButton = new QPushButton(i18n("Save selected keys as group..."));
+    m_deleteRecipientGroupButton = new QPushButton(i18n("Delete group"));
+
+    // the proxy does the sorting and the search filtering in memory
+    m_keyTableModel = new GPGKeyTableModel(this);
+    m_keyProxyModel = new GPGKeyFilterProxyModel(this);
+    m_keyProxyModel->setSourceModel(m_keyTableModel);
+    m_keyTableStatusLabel = new QLabel(i18n("Loading GPG keys..."));
+    m_keyTableStatusLabel->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+    m_gpgKeyTable = new QTableView(m_toolview.get());
+    m_gpgKeyTable->setModel(m_keyProxyModel);
     m_gpgKeyTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    // multiple rows select multiple recipients (Ctrl/Shift+click)
+    m_gpgKeyTable->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    m_gpgKeyTable->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+    m_gpgKeyTable->setHorizontalScrollMode(QAbstractItemView::ScrollPerPixel);
+    m_gpgKeyTable->setSortingEnabled(true);
+    m_gpgKeyTable->sortByColumn(GPGKeyTableModel::CreationDateColumn, Qt::DescendingOrder);
+    // only measure the visible part of the table instead of every single row
+    m_gpgKeyTable->horizontalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+    m_gpgKeyTable->horizontalHeader()->setResizeContentsPrecision(0);
+    // Sizing rows to their contents measures every row on each reset or
+    // filter change. All rows are one line high instead, keys with more
+    // than one UID show the others in the tooltip.
+    m_gpgKeyTable->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    m_gpgKeyTable->verticalHeader()->setDefaultSectionSize(m_gpgKeyTable->fontMetrics().lineSpacing() + 6);
+    m_gpgKeyTable->setMinimumHeight(250);
+    m_gpgKeyTable->setMaximumHeight(500);
+    m_gpgKeyTable->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
 
     // we want the settings stuff in QScrollArea
     QScrollArea *scrollArea = new QScrollArea(m_toolview.get());
@@ -133,30 +277,95 @@ KateGPGPluginView::KateGPGPluginView(KateGPGPlugin *plugin, KTextEditor::MainWin
     m_verticalLayout->addWidget(m_titleLabel);
     m_verticalLayout->addWidget(m_gpgDecryptButton);
     m_verticalLayout->addWidget(m_gpgEncryptButton);
+    m_verticalLayout->addWidget(m_gpgDecryptBlocksButton);
+    m_verticalLayout->addWidget(m_gpgDecryptFilesButton);
+    m_verticalLayout->addWidget(m_gpgEncryptFilesButton);
+    m_verticalLayout->addWidget(m_gpgReencryptFilesButton);
+    m_verticalLayout->addWidget(m_gpgCancelButton);
+    m_verticalLayout->addWidget(m_operationProgressBar);
+    m_verticalLayout->addWidget(m_showTimingsCheckbox);
+    m_verticalLayout->addWidget(m_operationTimingLabel);
     m_verticalLayout->addWidget(m_saveAsASCIICheckbox);
+    m_verticalLayout->addWidget(m_binaryGpgFilesCheckbox);
+    m_verticalLayout->addWidget(m_compressionLabel);
+    m_verticalLayout->addWidget(m_compressionComboBox);
+    QHBoxLayout *plaintextCacheLayout = new QHBoxLayout();
+    plaintextCacheLayout->addWidget(m_plaintextCacheCheckbox);
+    plaintextCacheLayout->addWidget(m_plaintextCacheMinutesSpinBox);
+    plaintextCacheLayout->addWidget(m_clearPlaintextCacheButton);
+    m_verticalLayout->addLayout(plaintextCacheLayout);
     m_verticalLayout->addWidget(m_symmetricEncryptioCheckbox);
+    m_verticalLayout->addWidget(m_inlineBlocksCheckbox);
     m_verticalLayout->addWidget(m_preferredEmailAddressLabel);
     m_verticalLayout->addWidget(m_preferredEmailLineEdit);
     m_verticalLayout->addWidget(m_EmailAddressSelectLabel);
     m_verticalLayout->addWidget(m_preferredEmailAddressComboBox);
     m_verticalLayout->addWidget(m_preferredGPGKeyIDLabel);
     m_verticalLayout->addWidget(m_selectedKeyIndexEdit);
+    m_verticalLayout->addWidget(m_recipientCountLabel);
+    m_verticalLayout->addWidget(m_encryptToSelfCheckbox);
+    m_verticalLayout->addWidget(m_recipientGroupComboBox);
+    m_verticalLayout->addWidget(m_saveRecipientGroupButton);
+    m_verticalLayout->addWidget(m_deleteRecipientGroupButton);
     m_verticalLayout->addWidget(m_showOnlyPrivateKeysCheckbox);
     m_verticalLayout->addWidget(m_hideExpiredKeysCheckbox);
+    m_verticalLayout->addWidget(m_keyTableStatusLabel);
     m_verticalLayout->addWidget(m_gpgKeyTable);
 
     m_verticalLayout->insertStretch(-1, 1);
 
-    connect(m_gpgKeyTable, SIGNAL(itemSelectionChanged()), this, SLOT(onTableViewSelection()));
-    connect(m_preferredEmailLineEdit, SIGNAL(textChanged(QString)), this, SLOT(onPreferredEmailAddressChanged(QString)));
+    connect(m_gpgKeyTable->selectionModel(), &QItemSelectionModel::selectionChanged, this, &KateGPGPluginView::onTableViewSelection);
+    // filter once typing pauses instead of on every keystroke
+    m_searchDebounceTimer = new QTimer(this);
+    m_searchDebounceTimer->setSingleShot(true);
+    m_searchDebounceTimer->setInterval(250);
+    connect(m_searchDebounceTimer, &QTimer::timeout, this, &KateGPGPluginView::onPreferredEmailAddressChanged);
+    connect(m_preferredEmailLineEdit, &QLineEdit::textChanged, m_searchDebounceTimer, qOverload<>(&QTimer::start));
     connect(m_showOnlyPrivateKeysCheckbox, SIGNAL(stateChanged(int)), this, SLOT(onShowOnlyPrivateKeysChanged()));
     connect(m_hideExpiredKeysCheckbox, SIGNAL(stateChanged(int)), this, SLOT(onHideExpiredKeysChanged()));
+    connect(m_compressionComboBox, qOverload<int>(&QComboBox::currentIndexChanged), this, [this](int index) {
+        m_gpgWrapper->setCompression(static_cast<GPGCompression>(index));
+    });
+    connect(m_plaintextCacheCheckbox, &QCheckBox::toggled, this, &KateGPGPluginView::updatePlaintextCache);
+    connect(m_plaintextCacheMinutesSpinBox, qOverload<int>(&QSpinBox::valueChanged), this, &KateGPGPluginView::updatePlaintextCache);
+    connect(m_clearPlaintextCacheButton, &QPushButton::released, m_gpgWrapper, &GPGMeWrapper::clearPlaintextCache);
+#ifdef HAVE_QTDBUS
+    // nothing decrypted stays in memory while the session is locked
+    QDBusConnection::sessionBus().connect(QStringLiteral("org.freedesktop.ScreenSaver"),
+                                          QStringLiteral("/org/freedesktop/ScreenSaver"),
+                                          QStringLiteral("org.freedesktop.ScreenSaver"),
+                                          QStringLiteral("ActiveChanged"),
+                                          this,
+                                          SLOT(onScreenSaverActiveChanged(bool)));
+#endif
+    connect(m_showTimingsCheckbox, &QCheckBox::toggled, this, [this](bool checked) {
+        m_operationTimingLabel->setVisible(checked && !m_operationTimingLabel->text().isEmpty());
+    });
     connect(m_gpgDecryptButton, SIGNAL(released()), this, SLOT(decryptButtonPressed()));
     connect(m_gpgEncryptButton, SIGNAL(released()), this, SLOT(encryptButtonPressed()));
+    connect(m_gpgDecryptBlocksButton, &QPushButton::released, this, &KateGPGPluginView::decryptAllBlocksButtonPressed);
+    connect(m_gpgDecryptFilesButton, SIGNAL(released()), this, SLOT(decryptFilesButtonPressed()));
+    connect(m_gpgEncryptFilesButton, SIGNAL(released()), this, SLOT(encryptFilesButtonPressed()));
+    connect(m_gpgReencryptFilesButton, &QPushButton::released, this, &KateGPGPluginView::reencryptFilesButtonPressed);
+    connect(m_gpgCancelButton, SIGNAL(released()), this, SLOT(cancelButtonPressed()));
+    connect(m_recipientGroupComboBox, qOverload<int>(&QComboBox::activated), this, &KateGPGPluginView::onRecipientGroupActivated);
+    connect(m_saveRecipientGroupButton, &QPushButton::released, this, &KateGPGPluginView::saveRecipientGroupButtonPressed);
+    connect(m_deleteRecipientGroupButton, &QPushButton::released, this, &KateGPGPluginView::deleteRecipientGroupButtonPressed);
+    connect(m_gpgWrapper, &GPGMeWrapper::fileOperationFinished, this, &KateGPGPluginView::onFileOperationFinished);
+    connect(m_gpgWrapper, &GPGMeWrapper::batchFileFinished, this, &KateGPGPluginView::onBatchFileFinished);
+    connect(m_gpgWrapper, &GPGMeWrapper::decryptionFinished, this, &KateGPGPluginView::onDecryptionFinished);
+    connect(m_gpgWrapper, &GPGMeWrapper::decryptionOfStringsFinished, this, &KateGPGPluginView::onBlockDecryptionFinished);
+    connect(m_gpgWrapper, &GPGMeWrapper::encryptionFinished, this, &KateGPGPluginView::onEncryptionFinished);
+    connect(m_gpgWrapper, &GPGMeWrapper::operationProgress, this, &KateGPGPluginView::onOperationProgress);
+    connect(m_gpgWrapper, &GPGMeWrapper::operationThroughput, this, &KateGPGPluginView::onOperationThroughput);
+    connect(m_gpgWrapper, &GPGMeWrapper::keysChanged, this, &KateGPGPluginView::onKeysChanged);
     // hook into open/save dialog
     connect(mainwindow, &KTextEditor::MainWindow::viewCreated, this, [this](KTextEditor::View *view) {
         connectToOpenAndSaveDialog(view->document());
     });
+    // Listing all keys can take seconds on a large keyring, so this is done in
+    // the background. The table gets filled in onKeysChanged().
+    m_gpgWrapper->loadKeyCacheAsync();
     updateKeyTable();
 
     // restore plugin config
@@ -165,22 +374,44 @@ KateGPGPluginView::KateGPGPluginView(KateGPGPlugin *plugin, KTextEditor::MainWin
 
 void KateGPGPluginView::onPreferredEmailAddressChanged()
 {
-    m_gpgKeyTable->itemSelectionChanged();
     m_preferredEmailAddress = m_preferredEmailLineEdit->text();
-    updateKeyTable();
+    // the proxy only removes/inserts the rows that changed
+    m_keyProxyModel->setSearchString(m_preferredEmailAddress);
+    if (!m_gpgKeyTable->selectionModel()->hasSelection() && m_keyProxyModel->rowCount() > 0) {
+        m_gpgKeyTable->selectRow(0);
+    }
 }
 
 void KateGPGPluginView::onShowOnlyPrivateKeysChanged()
 {
-    m_gpgKeyTable->itemSelectionChanged();
-    m_preferredEmailAddress = m_preferredEmailLineEdit->text();
-    updateKeyTable();
+    reloadKeys();
 }
 
 void KateGPGPluginView::onHideExpiredKeysChanged()
 {
-    m_gpgKeyTable->itemSelectionChanged();
-    m_preferredEmailAddress = m_preferredEmailLineEdit->text();
+    reloadKeys();
+}
+
+void KateGPGPluginView::onKeysChanged()
+{
+    m_keyTableStatusLabel->hide();
+    // keep the user's (or the restored) selection instead of jumping to row 0
+    const int selectedRow = m_selectedRowIndex;
+    const int mailAddressIndex = m_restoredMailAddressIndex >= 0 ? m_restoredMailAddressIndex : m_preferredEmailAddressComboBox->currentIndex();
+    m_restoredMailAddressIndex = -1;
+    reloadKeys();
+    if (selectedRow < m_keyProxyModel->rowCount()) {
+        m_gpgKeyTable->selectRow(selectedRow);
+        if (mailAddressIndex >= 0 && mailAddressIndex < m_preferredEmailAddressComboBox->count()) {
+            m_preferredEmailAddressComboBox->setCurrentIndex(mailAddressIndex);
+        }
+    }
+}
+
+void KateGPGPluginView::reloadKeys()
+{
+    // searching is done by the proxy model, not by the wrapper
+    m_gpgWrapper->loadKeys(m_showOnlyPrivateKeysCheckbox->isChecked(), m_hideExpiredKeysCheckbox->isChecked(), QString());
     updateKeyTable();
 }
 
@@ -195,36 +426,262 @@ QVariantMap KateGPGPluginView::generateMessage(const QString translatebleMessage
 
 void KateGPGPluginView::connectToOpenAndSaveDialog(KTextEditor::Document *doc)
 {
-    connect(doc, &KTextEditor::Document::aboutToSave, this, &KateGPGPluginView::onDocumentWillSave);
+    // called for every view of the document, e.g. with a split view
+    connect(doc, &KTextEditor::Document::aboutToSave, this, &KateGPGPluginView::onDocumentWillSave, Qt::UniqueConnection);
+    connect(doc, &KTextEditor::Document::documentSavedOrUploaded, this, &KateGPGPluginView::onDocumentSaved, Qt::UniqueConnection);
+    connect(doc, &KTextEditor::Document::aboutToClose, this, &KateGPGPluginView::onDocumentAboutToClose, Qt::UniqueConnection);
     onDocumentOpened(doc);
 }
 
+/**
+ * @brief Returns only the first lines of a document. This is all
+ *        GPGMeWrapper::isEncrypted() needs to look at, there is no
+ *        need to copy the whole text of large documents. Not for the
+ *        strict check, that one needs the complete message.
+ */
+QString documentHeader(const KTextEditor::Document *doc)
+{
+    QString header;
+    const int numLines = qMin(doc->lines(), 40);
+    for (int i = 0; i < numLines; ++i) {
+        header += doc->line(i) + QLatin1Char('\n');
+    }
+    return header;
+}
+
+/**
+ * @brief SHA-256 of the document text, computed line by line
+ *        without copying the whole text.
+ */
+QByteArray documentDigest(const KTextEditor::Document *doc)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    for (int i = 0; i < doc->lines(); ++i) {
+        hash.addData(doc->line(i).toUtf8());
+        hash.addData(QByteArrayLiteral("\n"));
+    }
+    return hash.result();
+}
+
+/**
+ * @brief True if the document shows an unmodified binary OpenPGP file.
+ *        Kate mangles those bytes when loading them as text, so they have
+ *        to be decrypted from the file instead of the document text.
+ */
+bool isBinaryEncryptedDocument(const KTextEditor::Document *doc)
+{
+    return doc->url().isLocalFile() && !doc->isModified() && GPGMeWrapper::isBinaryEncryptedFile(doc->url().toLocalFile());
+}
+
+const QLatin1String PGPMessageBegin("-----BEGIN PGP MESSAGE-----");
+const QLatin1String PGPMessageEnd("-----END PGP MESSAGE-----");
+
+/**
+ * @brief Finds the ASCII armored PGP message around cursor by only
+ *        looking at the lines above and below it, not at the whole text.
+ * @return The lines from BEGIN to END (inclusive) or an invalid range
+ *         if the cursor is not inside a message.
+ */
+KTextEditor::Range armoredBlockAt(const KTextEditor::Document *doc, const KTextEditor::Cursor &cursor)
+{
+    int beginLine = -1;
+    for (int line = cursor.line(); line >= 0; --line) {
+        const QString text = doc->line(line).trimmed();
+        if (text.startsWith(PGPMessageBegin)) {
+            beginLine = line;
+            break;
+        }
+        if (line != cursor.line() && text.startsWith(PGPMessageEnd)) {
+            return KTextEditor::Range::invalid(); // the cursor is below a block
+        }
+    }
+    if (beginLine < 0) {
+        return KTextEditor::Range::invalid();
+    }
+    const int numLines = doc->lines();
+    for (int line = cursor.line(); line < numLines; ++line) {
+        const QString text = doc->line(line).trimmed();
+        if (text.startsWith(PGPMessageEnd)) {
+            return KTextEditor::Range(beginLine, 0, line, doc->lineLength(line));
+        }
+        if (line != beginLine && text.startsWith(PGPMessageBegin)) {
+            break; // unterminated block
+        }
+    }
+    return KTextEditor::Range::invalid();
+}
+
+/**
+ * @brief Collects the ranges of all ASCII armored PGP messages in a document
+ *        in one pass over its lines.
+ */
+QVector<KTextEditor::Range> findArmoredBlocks(const KTextEditor::Document *doc)
+{
+    QVector<KTextEditor::Range> blocks;
+    int beginLine = -1;
+    const int numLines = doc->lines();
+    for (int line = 0; line < numLines; ++line) {
+        const QString text = doc->line(line).trimmed();
+        if (text.startsWith(PGPMessageBegin)) {
+            beginLine = line; // an unterminated block before is ignored
+        } else if (beginLine >= 0 && text.startsWith(PGPMessageEnd)) {
+            blocks.append(KTextEditor::Range(beginLine, 0, line, doc->lineLength(line)));
+            beginLine = -1;
+        }
+    }
+    return blocks;
+}
+
 void KateGPGPluginView::onDocumentOpened(KTextEditor::Document *doc)
 {
     if ((doc->url().fileName().toLower().endsWith(QLatin1String(".gpg")) || doc->url().fileName().toLower().endsWith(QLatin1String(".asc")))
-        && m_gpgWrapper->isEncrypted(doc->text())) {
-        decryptButtonPressed();
+        && (m_gpgWrapper->isEncrypted(documentHeader(doc)) || isBinaryEncryptedDocument(doc))) {
+        decryptCurrentDocument(false);
     }
 }
 
+void KateGPGPluginView::onDocumentSaved(KTextEditor::Document *doc, bool saveAs)
+{
+    Q_UNUSED(saveAs);
+    // Kate can only write the armored text of the document, the file
+    // gets converted to raw packets afterwards (.asc always stays armored)
+    if (!m_binaryGpgFilesCheckbox->isChecked() || !doc->url().isLocalFile() || !doc->url().fileName().toLower().endsWith(QLatin1String(".gpg"))
+        || !doc->line(0).startsWith(PGPMessageBegin)) {
+        return;
+    }
+    QString errorMessage;
+    if (!GPGMeWrapper::dearmorFile(doc->url().toLocalFile(), errorMessage)) {
+        m_mainWindow->showMessage(generateMessage(i18n("The file was saved ASCII armored!\n") + errorMessage, QStringLiteral("Warning")));
+        return;
+    }
+    // the file on disk intentionally differs from the (armored) document text now
+#if QT_VERSION_MAJOR < 6
+    if (auto *modificationInterface = qobject_cast<KTextEditor::ModificationInterface *>(doc)) {
+        modificationInterface->setModifiedOnDiskWarning(false);
+    }
+#else
+    doc->setModifiedOnDiskWarning(false);
+#endif
+}
+
 void KateGPGPluginView::onDocumentWillSave(KTextEditor::Document *doc)
 {
     // Called right before save
     if (doc->url().fileName().toLower().endsWith(QLatin1String(".gpg")) || doc->url().fileName().toLower().endsWith(QLatin1String(".asc"))) {
         QList<KTextEditor::View *> views = m_mainWindow->views();
         KTextEditor::View *v = views.at(0);
-        if (m_gpgWrapper->isEncrypted(v->document()->text())) {
+        if (m_gpgWrapper->isEncrypted(documentHeader(v->document())) || isBinaryEncryptedDocument(v->document())) {
             m_mainWindow->showMessage(generateMessage(i18n("Attempted double encryption detected!\nEncrypting more "
                                                            "than once is disabled for now..."),
                                                       QStringLiteral("Warning")));
             return;
         }
-        v->document()->setText(v->document()->text());
-        encryptButtonPressed();
+        if (m_pendingDocument == v->document()) {
+            // the asynchronous result is outdated once we encrypted here
+            m_discardPendingResult = true;
+            m_gpgWrapper->cancelOperation();
+            v->document()->setReadWrite(m_pendingDocumentWasReadWrite);
+        }
+        encryptCurrentDocument(false);
+    }
+}
+
+void KateGPGPluginView::beginOperation(KTextEditor::Document *doc, const KTextEditor::Range &range)
+{
+    m_pendingDocument = doc;
+    m_pendingRange = range;
+    m_discardPendingResult = false;
+    if (doc) {
+        m_pendingDocumentWasReadWrite = doc->isReadWrite();
+        // the result replaces the whole text, so no edits in the meantime
+        doc->setReadWrite(false);
+    }
+    for (QPushButton *button : std::as_const(m_operationButtons)) {
+        button->setEnabled(false);
+    }
+    m_gpgCancelButton->setEnabled(true);
+    m_operationProgressBar->setRange(0, 0); // busy indicator until GpgME reports progress
+    m_hasByteProgress = false;
+}
+
+KTextEditor::Document *KateGPGPluginView::endOperation()
+{
+    for (QPushButton *button : std::as_const(m_operationButtons)) {
+        button->setEnabled(true);
+    }
+    m_gpgCancelButton->setEnabled(false);
+    m_operationProgressBar->setRange(0, 1);
+    m_operationProgressBar->setValue(0);
+    m_operationProgressBar->setTextVisible(false);
+    m_operationProgressBar->setToolTip(QString());
+    KTextEditor::Document *doc = m_pendingDocument.data();
+    m_pendingDocument.clear();
+    if (doc) {
+        doc->setReadWrite(m_pendingDocumentWasReadWrite);
+    }
+    if (m_discardPendingResult) {
+        m_discardPendingResult = false;
+        return nullptr;
+    }
+    return doc;
+}
+
+void KateGPGPluginView::updatePlaintextCache()
+{
+    m_gpgWrapper->setPlaintextCacheEnabled(m_plaintextCacheCheckbox->isChecked(), m_plaintextCacheMinutesSpinBox->value() * 60);
+}
+
+void KateGPGPluginView::onScreenSaverActiveChanged(bool active_)
+{
+    if (active_) {
+        m_gpgWrapper->clearPlaintextCache();
+    }
+}
+
+void KateGPGPluginView::cancelButtonPressed()
+{
+    m_gpgWrapper->cancelOperation();
+}
+
+void KateGPGPluginView::onOperationProgress(const QString &what_, int current_, int total_)
+{
+    Q_UNUSED(what_);
+    if (!m_gpgWrapper->isOperationRunning() || m_hasByteProgress) {
+        return;
+    }
+    if (total_ > 0) {
+        m_operationProgressBar->setRange(0, total_);
+        m_operationProgressBar->setValue(current_);
+    } else {
+        m_operationProgressBar->setRange(0, 0);
     }
 }
 
+void KateGPGPluginView::onOperationThroughput(qint64 processedBytes_, qint64 totalBytes_, double bytesPerSecond_)
+{
+    if (!m_gpgWrapper->isOperationRunning()) {
+        return;
+    }
+    m_hasByteProgress = true;
+    const QString rate = i18nc("@info:progress bytes per second", "%1/s", KFormat().formatByteSize(bytesPerSecond_));
+    if (totalBytes_ > 0) {
+        // permille, the int range of QProgressBar is too small for byte counts
+        m_operationProgressBar->setRange(0, 1000);
+        m_operationProgressBar->setValue(int(qMin<qint64>(1000, processedBytes_ * 1000 / totalBytes_)));
+        m_operationProgressBar->setFormat(QStringLiteral("%p% · ") + rate);
+    } else {
+        m_operationProgressBar->setRange(0, 0);
+        m_operationProgressBar->setFormat(KFormat().formatByteSize(double(processedBytes_)) + QStringLiteral(" · ") + rate);
+    }
+    m_operationProgressBar->setTextVisible(true);
+}
+
 void KateGPGPluginView::decryptButtonPressed()
+{
+    decryptCurrentDocument(m_inlineBlocksCheckbox->isChecked());
+}
+
+void KateGPGPluginView::decryptCurrentDocument(bool inlineBlocks_)
 {
     QList<KTextEditor::View *> views = m_mainWindow->views();
     if (views.size() < 1) {
@@ -240,7 +697,45 @@ void KateGPGPluginView::decryptButtonPressed()
         m_mainWindow->showMessage(generateMessage(i18n("Error Decrypting Text! No fingerprint selected..."), QStringLiteral("Error")));
         return;
     }
-    GPGOperationResult res = m_gpgWrapper->decryptString(v->document()->text(), m_selectedKeyIndexEdit->text());
+    if (m_gpgWrapper->isOperationRunning()) {
+        m_mainWindow->showMessage(generateMessage(i18n("Another GPG operation is still running..."), QStringLiteral("Warning")));
+        return;
+    }
+    KTextEditor::Range range = KTextEditor::Range::invalid();
+    if (inlineBlocks_) {
+        range = v->selection() ? v->selectionRange() : armoredBlockAt(v->document(), v->cursorPosition());
+        if (!range.isValid()) {
+            m_mainWindow->showMessage(
+                generateMessage(i18n("Error Decrypting Text! Select the text to decrypt or place the cursor inside a PGP message..."),
+                                QStringLiteral("Error")));
+            return;
+        }
+    }
+    // The document is only replaced once the worker thread is done
+    // (see onDecryptionFinished()), Kate stays responsive meanwhile.
+    if (!inlineBlocks_ && isBinaryEncryptedDocument(v->document())) {
+        beginOperation(v->document());
+        // Kate opens binary files read-only, the decrypted text is editable
+        m_pendingDocumentWasReadWrite = true;
+        m_gpgWrapper->decryptFileToStringAsync(v->document()->url().toLocalFile(), m_selectedKeyIndexEdit->text());
+        return;
+    }
+    // For a range only that part is copied and replaced.
+    beginOperation(v->document(), range);
+    m_gpgWrapper->decryptStringAsync(range.isValid() ? v->document()->text(range) : v->document()->text(), m_selectedKeyIndexEdit->text());
+}
+
+void KateGPGPluginView::onDecryptionFinished(const GPGOperationResult &res)
+{
+    const KTextEditor::Range range = m_pendingRange;
+    KTextEditor::Document *doc = endOperation();
+    if (!doc) {
+        return; // document closed in the meantime
+    }
+    if (res.cancelled) {
+        m_mainWindow->showMessage(generateMessage(i18n("Decryption cancelled..."), QStringLiteral("Information")));
+        return;
+    }
     if (!res.keyFound) {
         m_mainWindow->showMessage(generateMessage(i18n("Error Decrypting Text!\n"
                                                        "No matching fingerprint found!\n"
@@ -253,13 +748,60 @@ void KateGPGPluginView::decryptButtonPressed()
         m_mainWindow->showMessage(generateMessage(i18n("Error Decrypting Text!\n") + res.errorMessage, QStringLiteral("Error")));
         return;
     }
-    v->document()->setText(res.resultString);
+    QElapsedTimer timer;
+    timer.start();
+    // The ciphertext stays valid as long as the decrypted text is not
+    // changed, see encryptCurrentDocument(). Binary files are mangled in
+    // the document, those cannot be reused.
+    const bool keepCiphertext = !range.isValid() && doc->line(0).startsWith(PGPMessageBegin);
+    const QString ciphertext = keepCiphertext ? doc->text() : QString();
+    const bool decryptsFile = !range.isValid() && !doc->isModified();
+    if (!replaceDocumentText(doc, range, res.resultString)) {
+        return;
+    }
+    const QByteArray plaintextDigest = decryptsFile || keepCiphertext ? documentDigest(doc) : QByteArray();
+    if (decryptsFile) {
+        m_fileDigests.insert(doc, plaintextDigest);
+    }
+    GPGOperationTimings timings = res.timings;
+    timings.documentUpdateUs = timer.nsecsElapsed() / 1000;
+    reportOperationTimings(i18n("Decryption"), timings);
+    selectDecryptionKey(res);
+    if (keepCiphertext) {
+        // the recipients auto-selected for re-encryption above
+        rememberCiphertext(doc, plaintextDigest, ciphertext);
+    } else {
+        m_documentCiphertexts.remove(doc);
+    }
+}
+
+void KateGPGPluginView::rememberCiphertext(KTextEditor::Document *doc, const QByteArray &plaintextDigest, const QString &ciphertext)
+{
+    if (m_symmetricEncryptioCheckbox->isChecked()) {
+        // a new passphrase may be intended
+        m_documentCiphertexts.remove(doc);
+        return;
+    }
+    QStringList recipients = encryptionRecipients();
+    recipients.sort();
+    m_documentCiphertexts.insert(doc, {plaintextDigest, ciphertext, recipients, m_saveAsASCIICheckbox->isChecked(), m_gpgWrapper->compression()});
+}
+
+void KateGPGPluginView::onDocumentAboutToClose(KTextEditor::Document *doc)
+{
+    m_documentCiphertexts.remove(doc);
+    m_fileDigests.remove(doc);
+}
+
+void KateGPGPluginView::selectDecryptionKey(const GPGOperationResult &res)
+{
     // Search for decryption key ID in available keys
     // and autoselect corresponding row upon finding the correct one.
-    for (auto i = 0; i < m_gpgKeyTable->rowCount(); ++i) {
-        QTableWidgetItem *detailsItem = m_gpgKeyTable->item(i, 4);
-        QString detailsString = detailsItem->text();
-        if (detailsString.contains(res.keyIDUsedForDecryption)) {
+    for (auto i = 0; i < m_keyProxyModel->rowCount(); ++i) {
+        const GPGKeyDetails &keyDetail = m_keyTableModel->keyAt(m_keyProxyModel->mapToSource(m_keyProxyModel->index(i, 0)).row());
+        const QString subkeyID = keyDetail.subkeyID();
+        const bool usedForDecryption = !subkeyID.isEmpty() && res.keyIDUsedForDecryption.contains(subkeyID);
+        if (usedForDecryption) {
             m_selectedRowIndex = i;
             m_gpgKeyTable->selectRow(i);
             break;
@@ -267,7 +809,89 @@ void KateGPGPluginView::decryptButtonPressed()
     }
 }
 
+void KateGPGPluginView::decryptAllBlocksButtonPressed()
+{
+    QList<KTextEditor::View *> views = m_mainWindow->views();
+    if (views.size() < 1) {
+        m_mainWindow->showMessage(generateMessage(i18n("Error! No views available..."), QStringLiteral("Error")));
+        return;
+    }
+    KTextEditor::Document *doc = views.at(0)->document();
+    if (m_selectedKeyIndexEdit->text().isEmpty()) {
+        m_mainWindow->showMessage(generateMessage(i18n("Error Decrypting Text! No fingerprint selected..."), QStringLiteral("Error")));
+        return;
+    }
+    if (m_gpgWrapper->isOperationRunning()) {
+        m_mainWindow->showMessage(generateMessage(i18n("Another GPG operation is still running..."), QStringLiteral("Warning")));
+        return;
+    }
+    const QVector<KTextEditor::Range> blocks = findArmoredBlocks(doc);
+    if (blocks.isEmpty()) {
+        m_mainWindow->showMessage(generateMessage(i18n("No PGP message blocks found in the document..."), QStringLiteral("Information")));
+        return;
+    }
+    QStringList ciphertexts;
+    ciphertexts.reserve(blocks.size());
+    for (const KTextEditor::Range &block : blocks) {
+        ciphertexts.append(doc->text(block));
+    }
+    beginOperation(doc);
+    m_pendingBlockRanges = blocks;
+    m_gpgWrapper->decryptStringsAsync(ciphertexts, m_selectedKeyIndexEdit->text());
+}
+
+void KateGPGPluginView::onBlockDecryptionFinished(const GPGOperationResult &res)
+{
+    const QVector<KTextEditor::Range> blocks = std::exchange(m_pendingBlockRanges, {});
+    KTextEditor::Document *doc = endOperation();
+    if (!doc) {
+        return; // document closed in the meantime
+    }
+    // see replaceDocumentText(): the document may have been reloaded meanwhile
+    const KTextEditor::Range documentRange = doc->documentRange();
+    for (const KTextEditor::Range &block : blocks) {
+        if (!documentRange.contains(block)) {
+            m_mainWindow->showMessage(generateMessage(i18n("The document was changed while the GPG operation was running!\n"
+                                                           "The result was discarded, the document is left untouched."),
+                                                      QStringLiteral("Error")));
+            return;
+        }
+    }
+    QElapsedTimer timer;
+    timer.start();
+    int numDecrypted = 0;
+    {
+        // one undo step for all blocks, bottom up so the ranges above stay valid
+        KTextEditor::Document::EditingTransaction transaction(doc);
+        for (qsizetype i = qMin(blocks.size(), res.resultStrings.size()) - 1; i >= 0; --i) {
+            if (res.resultStrings.at(i).isNull()) {
+                continue;
+            }
+            doc->replaceText(blocks.at(i), res.resultStrings.at(i));
+            ++numDecrypted;
+        }
+    }
+    GPGOperationTimings timings = res.timings;
+    timings.documentUpdateUs = timer.nsecsElapsed() / 1000;
+    reportOperationTimings(i18np("Decryption of %1 block", "Decryption of %1 blocks", blocks.size()), timings);
+    if (res.cancelled) {
+        m_mainWindow->showMessage(generateMessage(i18n("Decryption cancelled, %1 of %2 blocks decrypted...", numDecrypted, blocks.size()),
+                                                  QStringLiteral("Information")));
+    } else if (!res.decryptionSuccess) {
+        m_mainWindow->showMessage(generateMessage(i18n("Only %1 of %2 blocks could be decrypted!\n", numDecrypted, blocks.size()) + res.errorMessage,
+                                                  QStringLiteral("Error")));
+    }
+    if (numDecrypted > 0) {
+        selectDecryptionKey(res);
+    }
+}
+
 void KateGPGPluginView::encryptButtonPressed()
+{
+    encryptCurrentDocument(true);
+}
+
+void KateGPGPluginView::encryptCurrentDocument(bool runAsync_)
 {
     QList<KTextEditor::View *> views = m_mainWindow->views();
     if (views.size() < 1) {
@@ -280,7 +904,7 @@ void KateGPGPluginView::encryptButtonPressed()
         m_mainWindow->showMessage(generateMessage(i18n("Error Encrypting Text! No document available..."), QStringLiteral("Error")));
         return;
     }
-    if (v->document()->text().isEmpty()) {
+    if (v->document()->isEmpty()) {
         m_mainWindow->showMessage(generateMessage(i18n("Error Encrypting Text! Document is empty..."), QStringLiteral("Error")));
         return;
     }
@@ -288,18 +912,84 @@ void KateGPGPluginView::encryptButtonPressed()
         m_mainWindow->showMessage(generateMessage(i18n("Error Encrypting Text!\nNo fingerprint selected..."), QStringLiteral("Error")));
         return;
     }
-    if (v->document()->text().startsWith(QLatin1String("-----BEGIN PGP MESSAGE-----"))) {
+    // the save path always encrypts the whole document
+    KTextEditor::Range range = KTextEditor::Range::invalid();
+    if (runAsync_ && m_inlineBlocksCheckbox->isChecked()) {
+        if (!v->selection()) {
+            m_mainWindow->showMessage(generateMessage(i18n("Error Encrypting Text! Select the text to encrypt..."), QStringLiteral("Error")));
+            return;
+        }
+        range = v->selectionRange();
+    }
+    const bool alreadyEncrypted = range.isValid() ? v->document()->text(range).contains(PGPMessageBegin) : v->document()->line(0).startsWith(PGPMessageBegin);
+    if (alreadyEncrypted) {
         m_mainWindow->showMessage(generateMessage(i18n("Attempted double encryption detected! Encrypting twice "
                                                        "is disabled for now..."),
                                                   QStringLiteral("Warning")));
         return;
     }
 
-    GPGOperationResult res = m_gpgWrapper->encryptString(v->document()->text(),
-                                                         m_selectedKeyIndexEdit->text(),
-                                                         m_preferredEmailAddressComboBox->itemText(m_preferredEmailAddressComboBox->currentIndex()),
-                                                         m_saveAsASCIICheckbox->isChecked(),
-                                                         m_symmetricEncryptioCheckbox->isChecked());
+    if (runAsync_) {
+        if (m_gpgWrapper->isOperationRunning()) {
+            m_mainWindow->showMessage(generateMessage(i18n("Another GPG operation is still running..."), QStringLiteral("Warning")));
+            return;
+        }
+        beginOperation(v->document(), range);
+        m_gpgWrapper->encryptStringAsync(range.isValid() ? v->document()->text(range) : v->document()->text(),
+                                         encryptionRecipients(),
+                                         m_preferredEmailAddressComboBox->itemText(m_preferredEmailAddressComboBox->currentIndex()),
+                                         m_saveAsASCIICheckbox->isChecked(),
+                                         m_symmetricEncryptioCheckbox->isChecked());
+        return;
+    }
+    // Saving without changes since the last decryption or save can reuse
+    // the ciphertext of back then, hashing is far cheaper than encrypting.
+    KTextEditor::Document *doc = v->document();
+    QElapsedTimer timer;
+    timer.start();
+    const QByteArray plaintextDigest = documentDigest(doc);
+    const auto known = m_documentCiphertexts.constFind(doc);
+    if (known != m_documentCiphertexts.constEnd() && !m_symmetricEncryptioCheckbox->isChecked() && known->plaintextDigest == plaintextDigest
+        && known->textMode == m_saveAsASCIICheckbox->isChecked() && known->compression == m_gpgWrapper->compression()) {
+        QStringList recipients = encryptionRecipients();
+        recipients.sort();
+        if (known->recipients == recipients) {
+            GPGOperationTimings timings;
+            timings.conversionUs = timer.nsecsElapsed() / 1000;
+            timer.restart();
+            replaceDocumentText(doc, KTextEditor::Range::invalid(), known->ciphertext);
+            timings.documentUpdateUs = timer.nsecsElapsed() / 1000;
+            reportOperationTimings(i18n("Encryption skipped, text unchanged"), timings);
+            return;
+        }
+    }
+    GPGOperationResult res = m_gpgWrapper->encryptDocument(doc,
+                                                           encryptionRecipients(),
+                                                           m_preferredEmailAddressComboBox->itemText(m_preferredEmailAddressComboBox->currentIndex()),
+                                                           m_saveAsASCIICheckbox->isChecked(),
+                                                           m_symmetricEncryptioCheckbox->isChecked());
+    if (res.decryptionSuccess) {
+        rememberCiphertext(doc, plaintextDigest, res.resultString);
+    }
+    applyEncryptionResult(doc, res);
+}
+
+void KateGPGPluginView::onEncryptionFinished(const GPGOperationResult &res)
+{
+    const KTextEditor::Range range = m_pendingRange;
+    KTextEditor::Document *doc = endOperation();
+    if (!doc) {
+        return; // document closed or already encrypted on save
+    }
+    if (res.cancelled) {
+        m_mainWindow->showMessage(generateMessage(i18n("Encryption cancelled..."), QStringLiteral("Information")));
+        return;
+    }
+    applyEncryptionResult(doc, res, range);
+}
+
+void KateGPGPluginView::applyEncryptionResult(KTextEditor::Document *doc, const GPGOperationResult &res, const KTextEditor::Range &range)
+{
     if (!res.keyFound) {
         m_mainWindow->showMessage(
             generateMessage(i18n("Error Encrypting Text! No Matching Fingerprint found...\n") + res.errorMessage, QStringLiteral("Error")));
@@ -309,93 +999,399 @@ void KateGPGPluginView::encryptButtonPressed()
         m_mainWindow->showMessage(generateMessage(i18n("Error Encrypting Text!") + res.errorMessage, QStringLiteral("Error")));
         return;
     }
-    v->document()->setText(res.resultString);
+    QElapsedTimer timer;
+    timer.start();
+    if (!replaceDocumentText(doc, range, res.resultString)) {
+        return;
+    }
+    GPGOperationTimings timings = res.timings;
+    timings.documentUpdateUs = timer.nsecsElapsed() / 1000;
+    reportOperationTimings(i18n("Encryption"), timings);
+}
+
+bool KateGPGPluginView::replaceDocumentText(KTextEditor::Document *doc, const KTextEditor::Range &range, const QString &text)
+{
+    // Every insert is split into a temporary list of lines by KTextEditor,
+    // inserting whole lines chunk by chunk keeps that list small.
+    constexpr qsizetype ChunkSize = 1024 * 1024;
+
+    // The document was read-only while the operation ran, but it can still
+    // have been reloaded from disk. A partial result must never replace the
+    // whole text then.
+    if (range.isValid() && !doc->documentRange().contains(range)) {
+        m_mainWindow->showMessage(generateMessage(i18n("The document was changed while the GPG operation was running!\n"
+                                                       "The result was discarded, the document is left untouched."),
+                                                  QStringLiteral("Error")));
+        return false;
+    }
+    const KTextEditor::Range target = range.isValid() ? range : doc->documentRange();
+    // one undo step and one re-layout for the whole replacement
+    KTextEditor::Document::EditingTransaction transaction(doc);
+    doc->removeText(target);
+    KTextEditor::Cursor cursor = target.start();
+    qsizetype pos = 0;
+    while (pos < text.size()) {
+        qsizetype end = qMin(pos + ChunkSize, text.size());
+        if (end < text.size()) {
+            const qsizetype newline = text.lastIndexOf(QLatin1Char('\n'), end - 1);
+            if (newline >= pos) {
+                end = newline + 1;
+            } else if (text.at(end - 1).isHighSurrogate()) {
+                --end; // a single very long line, but never split a character
+            }
+        }
+        const QString chunk = text.mid(pos, end - pos);
+        doc->insertText(cursor, chunk);
+        const qsizetype numNewlines = chunk.count(QLatin1Char('\n'));
+        if (numNewlines == 0) {
+            cursor.setColumn(cursor.column() + chunk.size());
+        } else {
+            cursor.setPosition(cursor.line() + numNewlines, chunk.size() - chunk.lastIndexOf(QLatin1Char('\n')) - 1);
+        }
+        pos = end;
+    }
+    return true;
+}
+
+void KateGPGPluginView::reportOperationTimings(const QString &operation_, const GPGOperationTimings &timings_)
+{
+    const QString text = operation_ + QStringLiteral(": ") + timings_.toString();
+    qCDebug(KATE_GPG_TIMING).noquote() << text;
+    m_operationTimingLabel->setText(text);
+    m_operationTimingLabel->setVisible(m_showTimingsCheckbox->isChecked());
+    // after a long operation tell the user what the time was spent on
+    const qint64 totalUs = timings_.keyLookupUs + timings_.contextSetupUs + timings_.cryptoUs + timings_.conversionUs + timings_.documentUpdateUs;
+    if (totalUs >= 2 * 1000 * 1000 && timings_.inputBytes > 0) {
+        const KFormat format;
+        const double seconds = totalUs / 1000000.0;
+        m_mainWindow->showMessage(generateMessage(i18n("%1: %2 in %3 (%4/s)",
+                                                       operation_,
+                                                       format.formatByteSize(double(timings_.inputBytes)),
+                                                       format.formatDuration(quint64(totalUs / 1000)),
+                                                       format.formatByteSize(timings_.inputBytes / seconds)),
+                                                  QStringLiteral("Information")));
+    }
+}
+
+QStringList KateGPGPluginView::selectFilesForOperation(const QString &caption_)
+{
+    // start in (and preselect) the file of the current document
+    QString startPath;
+    const QList<KTextEditor::View *> views = m_mainWindow->views();
+    if (!views.isEmpty() && views.at(0)->document()->url().isLocalFile()) {
+        startPath = views.at(0)->document()->url().toLocalFile();
+    }
+    return QFileDialog::getOpenFileNames(m_toolview.get(), caption_, startPath);
+}
+
+void KateGPGPluginView::encryptFilesButtonPressed()
+{
+    if (m_selectedKeyIndexEdit->text().isEmpty() && !m_symmetricEncryptioCheckbox->isChecked()) {
+        m_mainWindow->showMessage(generateMessage(i18n("Error Encrypting Files!\nNo fingerprint selected..."), QStringLiteral("Error")));
+        return;
+    }
+    const QStringList files = selectFilesForOperation(i18n("Select files to encrypt"));
+    if (files.isEmpty()) {
+        return;
+    }
+    if (!m_gpgWrapper->encryptFilesAsync(files,
+                                         encryptionRecipients(),
+                                         m_preferredEmailAddressComboBox->itemText(m_preferredEmailAddressComboBox->currentIndex()),
+                                         m_saveAsASCIICheckbox->isChecked(),
+                                         m_symmetricEncryptioCheckbox->isChecked())) {
+        m_mainWindow->showMessage(generateMessage(i18n("Another GPG operation is still running..."), QStringLiteral("Warning")));
+        return;
+    }
+    beginOperation(nullptr);
+}
+
+void KateGPGPluginView::decryptFilesButtonPressed()
+{
+    if (m_selectedKeyIndexEdit->text().isEmpty()) {
+        m_mainWindow->showMessage(generateMessage(i18n("Error Decrypting Files! No fingerprint selected..."), QStringLiteral("Error")));
+        return;
+    }
+    const QStringList files = selectFilesForOperation(i18n("Select files to decrypt"));
+    if (files.isEmpty()) {
+        return;
+    }
+    if (!m_gpgWrapper->decryptFilesAsync(files, m_selectedKeyIndexEdit->text())) {
+        m_mainWindow->showMessage(generateMessage(i18n("Another GPG operation is still running..."), QStringLiteral("Warning")));
+        return;
+    }
+    beginOperation(nullptr);
+}
+
+bool isEncryptedFileName(const QString &fileName_)
+{
+    return fileName_.endsWith(QLatin1String(".gpg"), Qt::CaseInsensitive) || fileName_.endsWith(QLatin1String(".asc"), Qt::CaseInsensitive)
+        || fileName_.endsWith(QLatin1String(".pgp"), Qt::CaseInsensitive);
+}
+
+bool KateGPGPluginView::isInSyncWithFile(KTextEditor::Document *doc) const
+{
+    if (!doc->isModified()) {
+        return true;
+    }
+    // auto-decrypted on open, but not edited since
+    const auto known = m_fileDigests.constFind(doc);
+    return known != m_fileDigests.constEnd() && *known == documentDigest(doc);
+}
+
+QStringList KateGPGPluginView::encryptedOpenDocumentFiles(QStringList &skippedFiles_) const
+{
+    QStringList files;
+    const QList<KTextEditor::Document *> documents = KTextEditor::Editor::instance()->application()->documents();
+    for (KTextEditor::Document *doc : documents) {
+        if (!doc->url().isLocalFile() || !isEncryptedFileName(doc->url().fileName())) {
+            continue;
+        }
+        const QString path = doc->url().toLocalFile();
+        // the file on disk is replaced, unsaved changes would be out of sync
+        if (!isInSyncWithFile(doc)) {
+            skippedFiles_.append(path);
+            continue;
+        }
+        files.append(path);
+    }
+    return files;
+}
+
+void KateGPGPluginView::reencryptFilesButtonPressed()
+{
+    // bounds the number of decrypted files held in memory at the same time
+    constexpr int MaxParallelFiles = 4;
+
+    const QStringList recipients = encryptionRecipients();
+    if (recipients.isEmpty()) {
+        m_mainWindow->showMessage(generateMessage(i18n("Error Re-encrypting Files!\nNo fingerprint selected..."), QStringLiteral("Error")));
+        return;
+    }
+    const QString openDocuments = i18n("All encrypted open documents");
+    const QString directory = i18n("All encrypted files in a directory...");
+    bool ok = false;
+    const QString source =
+        QInputDialog::getItem(m_toolview.get(), i18n("Re-encrypt files"), i18n("Files to re-encrypt:"), {openDocuments, directory}, 0, false, &ok);
+    if (!ok) {
+        return;
+    }
+    QStringList files;
+    QStringList skippedFiles;
+    if (source == openDocuments) {
+        files = encryptedOpenDocumentFiles(skippedFiles);
+    } else {
+        const QString dir = QFileDialog::getExistingDirectory(m_toolview.get(), i18n("Select directory to re-encrypt"));
+        if (dir.isEmpty()) {
+            return;
+        }
+        QDirIterator it(dir,
+                        {QStringLiteral("*.gpg"), QStringLiteral("*.asc"), QStringLiteral("*.pgp")},
+                        QDir::Files | QDir::NoSymLinks,
+                        QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            files.append(it.next());
+        }
+    }
+    if (!skippedFiles.isEmpty()) {
+        m_mainWindow->showMessage(generateMessage(i18n("Skipping documents with unsaved changes:\n%1", skippedFiles.join(QLatin1Char('\n'))),
+                                                  QStringLiteral("Warning")));
+    }
+    if (files.isEmpty()) {
+        m_mainWindow->showMessage(generateMessage(i18n("No encrypted files found..."), QStringLiteral("Information")));
+        return;
+    }
+    if (QMessageBox::question(m_toolview.get(),
+                              i18n("Re-encrypt files"),
+                              i18np("Re-encrypt %1 file to %2 key(s)?\nThe file is replaced on disk.",
+                                    "Re-encrypt %1 files to %2 key(s)?\nThe files are replaced on disk.",
+                                    files.size(),
+                                    recipients.size()))
+        != QMessageBox::Yes) {
+        return;
+    }
+    if (!m_gpgWrapper->reencryptFilesAsync(files, recipients, qMin(QThread::idealThreadCount(), MaxParallelFiles))) {
+        m_mainWindow->showMessage(generateMessage(i18n("Another GPG operation is still running..."), QStringLiteral("Warning")));
+        return;
+    }
+    beginOperation(nullptr);
+    m_operationProgressBar->setRange(0, files.size());
+    m_operationProgressBar->setValue(0);
+    m_operationProgressBar->setFormat(QStringLiteral("%v/%m"));
+    m_operationProgressBar->setTextVisible(true);
+}
+
+void KateGPGPluginView::onBatchFileFinished(const QString &path_, const QString &errorMessage_, int done_, int total_)
+{
+    if (errorMessage_.isEmpty()) {
+        // An open document of the file still holds the old ciphertext, saving
+        // it would bring back the old recipients. Only documents in sync with
+        // their file are re-encrypted, so nothing is lost here.
+        const QList<KTextEditor::Document *> documents = KTextEditor::Editor::instance()->application()->documents();
+        for (KTextEditor::Document *doc : documents) {
+            if (!doc->url().isLocalFile() || doc->url().toLocalFile() != path_ || !isInSyncWithFile(doc)) {
+                continue;
+            }
+            m_documentCiphertexts.remove(doc);
+            // A decrypted document already shows the plaintext of the new
+            // file and stays in sync with it, saving encrypts it afresh.
+            if (!doc->isModified()) {
+                doc->documentReload();
+            }
+        }
+    }
+    if (!m_gpgWrapper->isOperationRunning()) {
+        return;
+    }
+    m_operationProgressBar->setRange(0, total_);
+    m_operationProgressBar->setValue(done_);
+    // failures are collected in the summary of onFileOperationFinished()
+    m_operationProgressBar->setToolTip(errorMessage_.isEmpty() ? path_ : path_ + QStringLiteral(": ") + errorMessage_);
+}
+
+void KateGPGPluginView::onFileOperationFinished(const GPGOperationResult &res)
+{
+    endOperation();
+    reportOperationTimings(i18n("File operation"), res.timings);
+    if (!res.outputFiles.isEmpty()) {
+        m_mainWindow->showMessage(generateMessage(i18np("Wrote %2", "Wrote %1 files:\n%2", res.outputFiles.size(), res.outputFiles.join(QLatin1Char('\n'))),
+                                                  QStringLiteral("Information")));
+    }
+    if (res.cancelled) {
+        m_mainWindow->showMessage(generateMessage(i18n("File operation cancelled..."), QStringLiteral("Information")));
+        return;
+    }
+    if (!res.decryptionSuccess) {
+        m_mainWindow->showMessage(generateMessage(i18n("Error processing files!\n") + res.errorMessage, QStringLiteral("Error")));
+    }
 }
 
 void KateGPGPluginView::onTableViewSelection()
 {
     /**
-     * Thanks to sorting the table by creation date, we will here
-     * search for the selected table row by key fingerprint in the
-     * list of available GPG keys.
+     * The table is sorted and filtered by the proxy model, so the
+     * selected row is mapped back to the key in the source model.
      */
     m_preferredEmailAddressComboBox->clear();
-    m_gpgWrapper->loadKeys(m_showOnlyPrivateKeysCheckbox->isChecked(), m_hideExpiredKeysCheckbox->isChecked(), m_preferredEmailLineEdit->text());
     QModelIndexList selectedList = m_gpgKeyTable->selectionModel()->selectedRows();
-    // Currently it is possible to select multiple rows in the QTableWidget.
-    // For now we will only consider the first selected row.
+    // All selected rows are recipients for encryption. The first one
+    // selects the mail address and is used for decryption.
     if (selectedList.size() > 0) {
         m_selectedRowIndex = selectedList.at(0).row();
-        const QString selectedFingerPrint(m_gpgKeyTable->item(m_selectedRowIndex, 0)->text());
-        const QVector<GPGKeyDetails> keys = m_gpgWrapper->getKeys();
-        if (m_selectedRowIndex <= keys.size()) {
-            for (auto key = m_gpgWrapper->getKeys().begin(); key != m_gpgWrapper->getKeys().end(); ++key) {
-                GPGKeyDetails keyDetail = *key;
-                if (selectedFingerPrint == keyDetail.fingerPrint()) {
-                    const QVector<QString> mailAddresses = keyDetail.mailAdresses();
-                    for (auto &r : mailAddresses) {
-                        m_preferredEmailAddressComboBox->addItem(r);
-                    }
-                    m_selectedKeyIndexEdit->setText(keyDetail.fingerPrint());
-                    return;
-                }
-            }
+        const GPGKeyDetails &keyDetail = m_keyTableModel->keyAt(m_keyProxyModel->mapToSource(selectedList.at(0)).row());
+        for (auto &r : keyDetail.userIDs()) {
+            m_preferredEmailAddressComboBox->addItem(r.email);
+        }
+        m_selectedKeyIndexEdit->setText(keyDetail.fingerPrint());
+    }
+    m_recipientCountLabel->setText(i18np("Encrypting to %1 key", "Encrypting to %1 keys", selectedList.size()));
+    m_recipientCountLabel->setVisible(selectedList.size() > 1);
+}
+
+QStringList KateGPGPluginView::selectedFingerprints() const
+{
+    QStringList fingerprints;
+    const QModelIndexList selectedList = m_gpgKeyTable->selectionModel()->selectedRows();
+    for (const QModelIndex &index : selectedList) {
+        fingerprints.append(m_keyTableModel->keyAt(m_keyProxyModel->mapToSource(index).row()).fingerPrint());
+    }
+    return fingerprints;
+}
+
+QStringList KateGPGPluginView::encryptionRecipients() const
+{
+    QStringList recipients = selectedFingerprints();
+    if (m_encryptToSelfCheckbox->isChecked()) {
+        const QString ownFingerprint = m_gpgWrapper->defaultSecretKeyFingerprint();
+        if (!ownFingerprint.isEmpty() && !recipients.contains(ownFingerprint)) {
+            recipients.append(ownFingerprint);
+        }
+    }
+    return recipients;
+}
+
+void KateGPGPluginView::updateRecipientGroupComboBox(const QString &currentGroup_)
+{
+    m_recipientGroupComboBox->clear();
+    m_recipientGroupComboBox->addItem(i18n("Select a recipient group..."));
+    const QStringList groups = m_group.group(QStringLiteral("RecipientGroups")).keyList();
+    for (const QString &name : groups) {
+        m_recipientGroupComboBox->addItem(name);
+    }
+    const int index = m_recipientGroupComboBox->findText(currentGroup_);
+    m_recipientGroupComboBox->setCurrentIndex(qMax(index, 0));
+    m_deleteRecipientGroupButton->setEnabled(index > 0);
+}
+
+void KateGPGPluginView::onRecipientGroupActivated(int index_)
+{
+    m_deleteRecipientGroupButton->setEnabled(index_ > 0);
+    if (index_ <= 0) {
+        return;
+    }
+    const QStringList fingerprints =
+        m_group.group(QStringLiteral("RecipientGroups")).readEntry(m_recipientGroupComboBox->itemText(index_), QStringList());
+    // the group members may be hidden by the search string
+    m_preferredEmailLineEdit->clear();
+    m_searchDebounceTimer->stop();
+    onPreferredEmailAddressChanged();
+    QItemSelection selection;
+    QStringList missingFingerprints = fingerprints;
+    for (int row = 0; row < m_keyProxyModel->rowCount(); ++row) {
+        const QModelIndex index = m_keyProxyModel->index(row, 0);
+        const QString fingerprint = m_keyTableModel->keyAt(m_keyProxyModel->mapToSource(index).row()).fingerPrint();
+        if (missingFingerprints.removeAll(fingerprint) > 0) {
+            selection.select(index, index);
         }
     }
+    m_gpgKeyTable->selectionModel()->select(selection, QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows);
+    if (!missingFingerprints.isEmpty()) {
+        m_mainWindow->showMessage(generateMessage(i18n("These keys of the group are not available (expired, hidden or deleted):\n%1",
+                                                       missingFingerprints.join(QLatin1Char('\n'))),
+                                                  QStringLiteral("Warning")));
+    }
 }
 
-QString concatenateEmailAddressesToString(const QVector<QString> uids_, const QVector<QString> mailAddresses_, const QVector<QString> subkeyIDs_)
+void KateGPGPluginView::saveRecipientGroupButtonPressed()
 {
-    Q_ASSERT(uids_.size() == mailAddresses_.size());
-    QString out = QLatin1String("");
-    for (auto i = 0; i < mailAddresses_.size(); ++i) {
-        out += uids_.at(i) + QStringLiteral(" <");
-        out += mailAddresses_.at(i) + QStringLiteral("> ");
-        out += QStringLiteral("(") + subkeyIDs_.at(i) + QStringLiteral(")\n");
+    const QStringList fingerprints = selectedFingerprints();
+    if (fingerprints.isEmpty()) {
+        m_mainWindow->showMessage(generateMessage(i18n("Select the keys of the group in the table first..."), QStringLiteral("Warning")));
+        return;
     }
-    return out;
+    bool ok = false;
+    const QString name = QInputDialog::getText(m_toolview.get(),
+                                               i18n("Save recipient group"),
+                                               i18np("Name of the group (%1 key):", "Name of the group (%1 keys):", fingerprints.size()),
+                                               QLineEdit::Normal,
+                                               m_recipientGroupComboBox->currentIndex() > 0 ? m_recipientGroupComboBox->currentText() : QString(),
+                                               &ok)
+                             .trimmed();
+    if (!ok || name.isEmpty()) {
+        return;
+    }
+    KConfigGroup groups = m_group.group(QStringLiteral("RecipientGroups"));
+    groups.writeEntry(name, fingerprints);
+    groups.sync();
+    updateRecipientGroupComboBox(name);
 }
 
-void KateGPGPluginView::makeTableCell(const QString cellValue, uint row, uint col)
+void KateGPGPluginView::deleteRecipientGroupButtonPressed()
 {
-    QTableWidgetItem *item = new QTableWidgetItem(cellValue);
-    m_gpgKeyTable->setItem(row, col, item);
+    if (m_recipientGroupComboBox->currentIndex() <= 0) {
+        return;
+    }
+    KConfigGroup groups = m_group.group(QStringLiteral("RecipientGroups"));
+    groups.deleteEntry(m_recipientGroupComboBox->currentText());
+    groups.sync();
+    updateRecipientGroupComboBox();
 }
 
 void KateGPGPluginView::updateKeyTable()
 {
-    m_gpgKeyTable->setSortingEnabled(false);
-    m_gpgKeyTable->setRowCount(0);
-    m_gpgKeyTableHeader << i18n("Key Fingerprint") << i18n("Creation Date") << i18n("Expiry Date") << i18n("Key Length") << i18n("User IDs");
-    m_gpgKeyTable->setHorizontalHeaderLabels(m_gpgKeyTableHeader);
-    m_gpgKeyTable->resizeColumnsToContents();
-    const QVector<GPGKeyDetails> &keyDetailsList = m_gpgWrapper->getKeys();
-    uint numRows = 0;
-    for (uint row = 0; row < m_gpgWrapper->getNumKeys(); ++row) {
-        GPGKeyDetails keyDetail = keyDetailsList.at(row);
-        m_gpgKeyTable->insertRow(m_gpgKeyTable->rowCount());
-        makeTableCell(keyDetail.fingerPrint(), numRows, 0);
-        makeTableCell(keyDetail.creationDate(), numRows, 1);
-        makeTableCell(keyDetail.expiryDate(), numRows, 2);
-        makeTableCell(keyDetail.keyLength(), numRows, 3);
-        QString uidsAndMails(concatenateEmailAddressesToString(keyDetail.uids(), keyDetail.mailAdresses(), keyDetail.subkeyIDs()));
-        makeTableCell(uidsAndMails, numRows, 4);
-        ++numRows;
-    }
-    m_gpgKeyTable->resizeRowsToContents();
-    m_gpgKeyTable->setSelectionMode(QAbstractItemView::ContiguousSelection);
-    m_gpgKeyTable->sortByColumn(1, Qt::DescendingOrder);
-    m_gpgKeyTable->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
-    m_gpgKeyTable->setHorizontalScrollMode(QAbstractItemView::ScrollPerPixel);
-    m_gpgKeyTable->setSortingEnabled(true);
-    if (m_gpgKeyTable->rowCount() > 0) {
+    m_keyTableModel->setKeys(m_gpgWrapper->takeKeys());
+    if (m_keyProxyModel->rowCount() > 0) {
         m_gpgKeyTable->selectRow(0);
     }
-    m_gpgKeyTable->setMinimumHeight(250);
-    m_gpgKeyTable->setMaximumHeight(500);
-    m_gpgKeyTable->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
-    m_gpgKeyTable->resizeColumnsToContents();
-    m_gpgKeyTable->resizeRowsToContents();
 }
 
 #include "kategpgplugin.moc"
@@ -14,17 +14,24 @@
 #include <KTextEditor/View>
 #include <QCheckBox>
 #include <QComboBox>
+#include <QHash>
 #include <QLabel>
 #include <QLineEdit>
 #include <QObject>
+#include <QPointer>
+#include <QProgressBar>
 #include <QPushButton>
-#include <QTableWidget>
+#include <QSpinBox>
+#include <QTableView>
 #include <QTextBrowser>
 #include <QVBoxLayout>
 #include <memory>
 
 // forward declaration
 class GPGKeyDetails;
+class GPGKeyFilterProxyModel;
+class GPGKeyTableModel;
+class QTimer;
 
 class KateGPGPlugin : public KTextEditor::Plugin
 {
@@ -54,8 +61,27 @@ public Q_SLOTS:
     void onPreferredEmailAddressChanged();
     void onShowOnlyPrivateKeysChanged();
     void onHideExpiredKeysChanged();
+    void onKeysChanged(); // the keyring was modified outside of Kate
     void decryptButtonPressed();
+    void decryptAllBlocksButtonPressed();
     void encryptButtonPressed();
+    void encryptFilesButtonPressed();
+    void decryptFilesButtonPressed();
+    void reencryptFilesButtonPressed();
+    void cancelButtonPressed();
+    void updatePlaintextCache();
+    // wipes the plaintext cache when the screen gets locked
+    void onScreenSaverActiveChanged(bool active_);
+    void onDecryptionFinished(const GPGOperationResult &res);
+    void onBlockDecryptionFinished(const GPGOperationResult &res);
+    void onEncryptionFinished(const GPGOperationResult &res);
+    void onFileOperationFinished(const GPGOperationResult &res);
+    void onBatchFileFinished(const QString &path_, const QString &errorMessage_, int done_, int total_);
+    void onOperationProgress(const QString &what_, int current_, int total_);
+    void onOperationThroughput(qint64 processedBytes_, qint64 totalBytes_, double bytesPerSecond_);
+    void onRecipientGroupActivated(int index_);
+    void saveRecipientGroupButtonPressed();
+    void deleteRecipientGroupButtonPressed();
 
 private:
     KTextEditor::MainWindow *m_mainWindow = nullptr;
@@ -67,9 +93,50 @@ private:
     GPGMeWrapper *m_gpgWrapper = nullptr;
 
     int m_selectedRowIndex = 0;
+    // saved mail address index, applied once the keys are loaded in the background
+    int m_restoredMailAddressIndex = -1;
 
     QPushButton *m_gpgDecryptButton = nullptr;
     QPushButton *m_gpgEncryptButton = nullptr;
+    QPushButton *m_gpgDecryptBlocksButton = nullptr;
+    QPushButton *m_gpgEncryptFilesButton = nullptr;
+    QPushButton *m_gpgDecryptFilesButton = nullptr;
+    QPushButton *m_gpgReencryptFilesButton = nullptr;
+    QPushButton *m_gpgCancelButton = nullptr;
+    // buttons that start an operation, disabled while one is running
+    QVector<QPushButton *> m_operationButtons;
+    QProgressBar *m_operationProgressBar = nullptr;
+    // the running operation reports the bytes it has read, GpgME's progress is ignored then
+    bool m_hasByteProgress = false;
+    QCheckBox *m_showTimingsCheckbox = nullptr;
+    QLabel *m_operationTimingLabel = nullptr; // phase timing of the last operation
+
+    // The document an asynchronous de-/encryption is running for.
+    // It is set read-only until the result has been applied.
+    QPointer<KTextEditor::Document> m_pendingDocument;
+    bool m_pendingDocumentWasReadWrite = true;
+    // The part of the pending document the result replaces, invalid for the whole text
+    KTextEditor::Range m_pendingRange = KTextEditor::Range::invalid();
+    // The inline PGP blocks of the pending document decryptAllBlocksButtonPressed() works on
+    QVector<KTextEditor::Range> m_pendingBlockRanges;
+    // The last ciphertext of a document (from decryption or save) together
+    // with the SHA-256 of its plaintext and the encryption settings. Saving
+    // an unchanged document puts this ciphertext back instead of encrypting.
+    struct DocumentCiphertext {
+        QByteArray plaintextDigest;
+        QString ciphertext;
+        QStringList recipients; // sorted
+        bool textMode = true;
+        GPGCompression compression = GPGCompression::Default;
+    };
+    QHash<KTextEditor::Document *, DocumentCiphertext> m_documentCiphertexts;
+    // SHA-256 of the plaintext of a document's file, set when the unmodified
+    // document got decrypted as a whole. Decrypting marks the document
+    // modified, with this text it still matches the file on disk.
+    QHash<KTextEditor::Document *, QByteArray> m_fileDigests;
+    // Set if the pending document got encrypted synchronously on save
+    // in the meantime, so the asynchronous result must not be applied.
+    bool m_discardPendingResult = false;
 
     QVBoxLayout *m_verticalLayout;
     QLabel *m_titleLabel;
@@ -86,17 +153,65 @@ private:
     QCheckBox *m_symmetricEncryptioCheckbox;
     QCheckBox *m_showOnlyPrivateKeysCheckbox;
     QCheckBox *m_hideExpiredKeysCheckbox;
-    QTableWidget *m_gpgKeyTable;
-    QStringList m_gpgKeyTableHeader;
+    QCheckBox *m_encryptToSelfCheckbox = nullptr;
+    QCheckBox *m_binaryGpgFilesCheckbox = nullptr; // .gpg files are stored as raw OpenPGP packets
+    QLabel *m_compressionLabel = nullptr;
+    QComboBox *m_compressionComboBox = nullptr; // index is a GPGCompression
+    QCheckBox *m_plaintextCacheCheckbox = nullptr; // see GPGMeWrapper::setPlaintextCacheEnabled()
+    QSpinBox *m_plaintextCacheMinutesSpinBox = nullptr;
+    QPushButton *m_clearPlaintextCacheButton = nullptr;
+    QCheckBox *m_inlineBlocksCheckbox = nullptr; // de-/encrypt only the selection or the PGP block at the cursor
+    QLabel *m_recipientCountLabel = nullptr; // shown if more than one key is selected
+    // named sets of recipient fingerprints, stored in the "RecipientGroups" config group
+    QComboBox *m_recipientGroupComboBox = nullptr;
+    QPushButton *m_saveRecipientGroupButton = nullptr;
+    QPushButton *m_deleteRecipientGroupButton = nullptr;
+    QTableView *m_gpgKeyTable;
+    QLabel *m_keyTableStatusLabel; // shown while the keyring is loaded in the background
+    GPGKeyTableModel *m_keyTableModel = nullptr;
+    GPGKeyFilterProxyModel *m_keyProxyModel = nullptr;
+    QTimer *m_searchDebounceTimer = nullptr;
 
     KConfigGroup m_group;
 
     // private functions
     void updateKeyTable();
-
-    const QTableWidgetItem convertKeyDetailsToTableItem(const GPGKeyDetails &keyDetails_);
-
-    void makeTableCell(const QString cellValue, uint row, uint col);
+    void updateRecipientGroupComboBox(const QString &currentGroup_ = QString());
+    // fingerprints of all selected rows, the first one is the "current" key
+    QStringList selectedFingerprints() const;
+    // selectedFingerprints() plus the own key if "encrypt to self" is enabled
+    QStringList encryptionRecipients() const;
+    void reloadKeys(); // loadKeys() with the current settings + updateKeyTable()
+
+    // Encrypts the current document. The save path has to run synchronously
+    // because the encrypted text must be in place before Kate writes the file.
+    void encryptCurrentDocument(bool runAsync_);
+    void applyEncryptionResult(KTextEditor::Document *doc, const GPGOperationResult &res, const KTextEditor::Range &range = KTextEditor::Range::invalid());
+    // Decrypts the current document, or only the selection resp. the PGP block
+    // at the cursor if inlineBlocks_ is set (see m_inlineBlocksCheckbox)
+    void decryptCurrentDocument(bool inlineBlocks_);
+    // Replaces range (or the whole text if it is invalid) with text in one
+    // undo step, large texts are inserted in chunks of whole lines.
+    // Returns false (and tells the user) if range no longer fits the document.
+    bool replaceDocumentText(KTextEditor::Document *doc, const KTextEditor::Range &range, const QString &text);
+    // Selects the key that was used for decryption in the table
+    void selectDecryptionKey(const GPGOperationResult &res);
+    // see m_documentCiphertexts, plaintextDigest is the SHA-256 of the document text
+    void rememberCiphertext(KTextEditor::Document *doc, const QByteArray &plaintextDigest, const QString &ciphertext);
+    // Logs the timing of a finished operation and shows it if enabled
+    void reportOperationTimings(const QString &operation_, const GPGOperationTimings &timings_);
+
+    // Lock/unlock the UI and the document (if any) while an asynchronous operation runs.
+    // endOperation() returns the document the result should be applied to.
+    void beginOperation(KTextEditor::Document *doc, const KTextEditor::Range &range = KTextEditor::Range::invalid());
+    KTextEditor::Document *endOperation();
+
+    // Asks for files to process, starting at the current document's file
+    QStringList selectFilesForOperation(const QString &caption_);
+    // false if doc has changes that are not in its file (see m_fileDigests)
+    bool isInSyncWithFile(KTextEditor::Document *doc) const;
+    // local files of all open .gpg/.asc/.pgp documents, ones with unsaved changes go to skippedFiles_
+    QStringList encryptedOpenDocumentFiles(QStringList &skippedFiles_) const;
 
     void readPluginConfig();
     void savePluginConfig();
@@ -106,6 +221,9 @@ private:
     void connectToOpenAndSaveDialog(KTextEditor::Document *doc);
     void onDocumentWillSave(KTextEditor::Document *doc);
     void onDocumentOpened(KTextEditor::Document *doc);
+    // converts saved .gpg files to binary, see m_binaryGpgFilesCheckbox
+    void onDocumentSaved(KTextEditor::Document *doc, bool saveAs);
+    void onDocumentAboutToClose(KTextEditor::Document *doc);
 
     // Function to generate translatable Kate-conform error/warning messages
     QVariantMap generateMessage(const QString translatebleMessage, const QString messageType);
@@ -0,0 +1,102 @@
+/*
+    SPDX-FileCopyrightText: 2025 Dennis Lübke <kde@dennis2society.de>
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "plaintextcache.hpp"
+
+#include <QCryptographicHash>
+#include <QMutexLocker>
+
+#include <cstring>
+#include <utility>
+
+PlaintextCache::PlaintextCache(size_t maxEntries_)
+    : m_maxEntries(maxEntries_)
+{
+    m_clock.start();
+}
+
+QByteArray PlaintextCache::digest(const QByteArray &ciphertext_)
+{
+    return QCryptographicHash::hash(ciphertext_, QCryptographicHash::Sha256);
+}
+
+void PlaintextCache::setTimeToLive(qint64 msecs_)
+{
+    QMutexLocker locker(&m_mutex);
+    m_timeToLive = msecs_;
+}
+
+bool PlaintextCache::find(const QByteArray &digest_, QString &plaintext_, QString &keyID_)
+{
+    QMutexLocker locker(&m_mutex);
+    removeExpiredLocked();
+    const auto it = m_entries.find(digest_);
+    if (it == m_entries.end()) {
+        return false;
+    }
+    const SecureBuffer &buffer = it->second.plaintext;
+    plaintext_ = QString::fromUtf8(buffer.data(), static_cast<qsizetype>(buffer.size()));
+    keyID_ = it->second.keyID;
+    return true;
+}
+
+void PlaintextCache::insert(const QByteArray &digest_, const QString &plaintext_, const QString &keyID_)
+{
+    QByteArray utf8 = plaintext_.toUtf8();
+    Entry entry;
+    entry.plaintext = SecureBuffer(static_cast<size_t>(utf8.size()));
+    if (!utf8.isEmpty() && entry.plaintext.isNull()) {
+        secureZero(utf8.data(), utf8.size());
+        return;
+    }
+    if (!utf8.isEmpty()) {
+        std::memcpy(entry.plaintext.data(), utf8.constData(), utf8.size());
+    }
+    // the temporary copy is not locked, at least it doesn't stay in the heap
+    secureZero(utf8.data(), utf8.size());
+    entry.keyID = keyID_;
+
+    QMutexLocker locker(&m_mutex);
+    if (m_maxEntries == 0) {
+        return;
+    }
+    entry.expiresAt = m_clock.elapsed() + m_timeToLive;
+    removeExpiredLocked();
+    m_entries.erase(digest_);
+    while (m_entries.size() >= m_maxEntries) {
+        auto oldest = m_entries.begin();
+        for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+            if (it->second.expiresAt < oldest->second.expiresAt) {
+                oldest = it;
+            }
+        }
+        m_entries.erase(oldest);
+    }
+    m_entries.emplace(digest_, std::move(entry));
+}
+
+void PlaintextCache::removeExpired()
+{
+    QMutexLocker locker(&m_mutex);
+    removeExpiredLocked();
+}
+
+void PlaintextCache::removeExpiredLocked()
+{
+    const qint64 now = m_clock.elapsed();
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (it->second.expiresAt <= now) {
+            it = m_entries.erase(it); // SecureBuffer wipes itself
+        } else {
+            ++it;
+        }
+    }
+}
+
+void PlaintextCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_entries.clear();
+}
@@ -0,0 +1,74 @@
+/*
+    SPDX-FileCopyrightText: 2025 Dennis Lübke <kde@dennis2society.de>
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#pragma once
+
+/**
+ * @brief Remembers decrypted texts for a limited time, so reopening an
+ * unchanged encrypted file costs a SHA-256 of the ciphertext instead of
+ * a gpg-agent round trip. The plaintexts are kept UTF-8 encoded in
+ * locked memory (see SecureBuffer) and wiped when they expire, when the
+ * cache is cleared and on destruction.
+ * All functions are thread-safe.
+ */
+
+#include "securememory.hpp"
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QString>
+
+#include <map>
+
+class PlaintextCache
+{
+public:
+    /**
+     * @param maxEntries_ The entry closest to expiry is dropped when
+     *        more plaintexts are added.
+     */
+    explicit PlaintextCache(size_t maxEntries_ = 32);
+
+    /**
+     * @brief The digest a ciphertext is cached under (SHA-256).
+     */
+    static QByteArray digest(const QByteArray &ciphertext_);
+
+    /**
+     * @brief How long a plaintext stays cached after it was added.
+     *        Applies to entries added afterwards.
+     */
+    void setTimeToLive(qint64 msecs_);
+
+    /**
+     * @brief Looks up the plaintext of the ciphertext with digest_.
+     * @return false if there is no (unexpired) entry.
+     */
+    bool find(const QByteArray &digest_, QString &plaintext_, QString &keyID_);
+
+    void insert(const QByteArray &digest_, const QString &plaintext_, const QString &keyID_);
+
+    // wipes the entries whose time to live has passed
+    void removeExpired();
+
+    // wipes all entries
+    void clear();
+
+private:
+    struct Entry {
+        SecureBuffer plaintext; // UTF-8
+        QString keyID; // the key ID(s) used for decryption
+        qint64 expiresAt = 0; // msecs of m_clock
+    };
+
+    void removeExpiredLocked();
+
+    QMutex m_mutex;
+    std::map<QByteArray, Entry> m_entries;
+    QElapsedTimer m_clock; // monotonic, wall clock changes do not matter
+    qint64 m_timeToLive = 10 * 60 * 1000;
+    size_t m_maxEntries;
+};
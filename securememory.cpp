@@ -0,0 +1,211 @@
+/*
+    SPDX-FileCopyrightText: 2025 Dennis Lübke <kde@dennis2society.de>
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include "securememory.hpp"
+
+#include <QMutexLocker>
+#include <QtGlobal>
+
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#endif
+
+// smallest size handed out by SecureBufferPool, also the usual page size multiple
+constexpr size_t MinBufferSize = 64 * 1024;
+
+void secureZero(void *data_, size_t size_)
+{
+    // the volatile writes must not be dropped as dead stores
+    volatile unsigned char *p = static_cast<volatile unsigned char *>(data_);
+    while (size_--) {
+        *p++ = 0;
+    }
+}
+
+SecureBuffer::SecureBuffer(size_t size_)
+{
+    if (size_ == 0) {
+        return;
+    }
+    m_data = static_cast<char *>(std::calloc(size_, 1));
+    if (!m_data) {
+        return;
+    }
+    m_size = size_;
+#ifdef Q_OS_UNIX
+    // fails beyond RLIMIT_MEMLOCK, the buffer is usable anyway
+    m_locked = mlock(m_data, m_size) == 0;
+#endif
+}
+
+SecureBuffer::~SecureBuffer()
+{
+    release();
+}
+
+SecureBuffer::SecureBuffer(SecureBuffer &&other_) noexcept
+    : m_data(std::exchange(other_.m_data, nullptr))
+    , m_size(std::exchange(other_.m_size, 0))
+    , m_locked(std::exchange(other_.m_locked, false))
+{
+}
+
+SecureBuffer &SecureBuffer::operator=(SecureBuffer &&other_) noexcept
+{
+    if (this != &other_) {
+        release();
+        m_data = std::exchange(other_.m_data, nullptr);
+        m_size = std::exchange(other_.m_size, 0);
+        m_locked = std::exchange(other_.m_locked, false);
+    }
+    return *this;
+}
+
+void SecureBuffer::release()
+{
+    if (!m_data) {
+        return;
+    }
+    secureZero(m_data, m_size);
+#ifdef Q_OS_UNIX
+    if (m_locked) {
+        munlock(m_data, m_size);
+    }
+#endif
+    std::free(m_data);
+    m_data = nullptr;
+    m_size = 0;
+    m_locked = false;
+}
+
+SecureBufferPool &SecureBufferPool::instance()
+{
+    // enough to keep the chunk buffers of a few parallel operations
+    static SecureBufferPool pool(16 * 1024 * 1024);
+    return pool;
+}
+
+SecureBufferPool::SecureBufferPool(size_t maxPooledBytes_)
+    : m_maxPooledBytes(maxPooledBytes_)
+{
+}
+
+SecureBufferPool::~SecureBufferPool() = default;
+
+SecureBuffer SecureBufferPool::acquire(size_t minSize_)
+{
+    size_t size = MinBufferSize;
+    while (size < minSize_) {
+        size *= 2;
+    }
+    {
+        QMutexLocker locker(&m_mutex);
+        for (auto it = m_buffers.begin(); it != m_buffers.end(); ++it) {
+            if (it->size() == size) {
+                SecureBuffer buffer = std::move(*it);
+                m_buffers.erase(it);
+                m_pooledBytes -= size;
+                return buffer;
+            }
+        }
+    }
+    return SecureBuffer(size);
+}
+
+void SecureBufferPool::recycle(SecureBuffer &&buffer_)
+{
+    if (buffer_.isNull()) {
+        return;
+    }
+    SecureBuffer buffer = std::move(buffer_);
+    // buffers not from acquire() (other sizes) are freed
+    if ((buffer.size() & (buffer.size() - 1)) != 0 || buffer.size() < MinBufferSize) {
+        return;
+    }
+    secureZero(buffer.data(), buffer.size());
+    QMutexLocker locker(&m_mutex);
+    if (m_pooledBytes + buffer.size() > m_maxPooledBytes) {
+        return; // released when going out of scope
+    }
+    m_pooledBytes += buffer.size();
+    m_buffers.push_back(std::move(buffer));
+}
+
+SecureByteArray::SecureByteArray(size_t capacity_)
+{
+    reserve(capacity_);
+}
+
+SecureByteArray::~SecureByteArray()
+{
+    SecureBufferPool::instance().recycle(std::move(m_buffer));
+}
+
+bool SecureByteArray::reserve(size_t capacity_)
+{
+    if (capacity_ <= m_buffer.size()) {
+        return true;
+    }
+    SecureBuffer buffer = SecureBufferPool::instance().acquire(capacity_);
+    if (buffer.isNull()) {
+        return false;
+    }
+    if (m_size > 0) {
+        std::memcpy(buffer.data(), m_buffer.data(), m_size);
+    }
+    SecureBufferPool::instance().recycle(std::move(m_buffer));
+    m_buffer = std::move(buffer);
+    return true;
+}
+
+bool SecureByteArray::append(const char *data_, size_t size_)
+{
+    if (size_ == 0) {
+        return true;
+    }
+    if (!reserve(m_size + size_)) {
+        return false;
+    }
+    std::memcpy(m_buffer.data() + m_size, data_, size_);
+    m_size += size_;
+    return true;
+}
+
+bool SecureByteArray::resize(size_t size_)
+{
+    if (size_ > m_size) {
+        if (!reserve(size_)) {
+            return false;
+        }
+        // pooled buffers are wiped, so the new bytes are zero
+    } else {
+        secureZero(m_buffer.data() + size_, m_size - size_);
+    }
+    m_size = size_;
+    return true;
+}
+
+void SecureByteArray::remove(size_t count_)
+{
+    count_ = qMin(count_, m_size);
+    if (count_ == 0) {
+        return;
+    }
+    std::memmove(m_buffer.data(), m_buffer.data() + count_, m_size - count_);
+    secureZero(m_buffer.data() + m_size - count_, count_);
+    m_size -= count_;
+}
+
+void SecureByteArray::clear()
+{
+    if (m_size > 0) {
+        secureZero(m_buffer.data(), m_size);
+    }
+    m_size = 0;
+}
@@ -0,0 +1,153 @@
+/*
+    SPDX-FileCopyrightText: 2025 Dennis Lübke <kde@dennis2society.de>
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#pragma once
+
+/**
+ * @brief Memory for plaintext that should neither end up in swap nor
+ * linger in freed heap memory. The pages are locked into RAM (if the
+ * memlock limit allows it) and overwritten with zeros before they are
+ * released.
+ */
+
+#include <QMutex>
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Overwrites size_ bytes at data_ with zeros in a way the
+ *        compiler cannot optimize away.
+ */
+void secureZero(void *data_, size_t size_);
+
+class SecureBuffer
+{
+public:
+    SecureBuffer() = default;
+
+    /**
+     * @brief Allocates size_ zero initialized bytes. Check isNull(),
+     *        the allocation fails if no memory is left.
+     */
+    explicit SecureBuffer(size_t size_);
+
+    ~SecureBuffer();
+
+    SecureBuffer(SecureBuffer &&other_) noexcept;
+    SecureBuffer &operator=(SecureBuffer &&other_) noexcept;
+    SecureBuffer(const SecureBuffer &) = delete;
+    SecureBuffer &operator=(const SecureBuffer &) = delete;
+
+    char *data()
+    {
+        return m_data;
+    }
+    const char *data() const
+    {
+        return m_data;
+    }
+    size_t size() const
+    {
+        return m_size;
+    }
+    bool isNull() const
+    {
+        return m_data == nullptr;
+    }
+
+    // false if the memlock limit was exceeded, the buffer is still wiped on release
+    bool isLocked() const
+    {
+        return m_locked;
+    }
+
+    // zeroes and frees the memory
+    void release();
+
+private:
+    char *m_data = nullptr;
+    size_t m_size = 0;
+    bool m_locked = false;
+};
+
+/**
+ * @brief Keeps released SecureBuffers for reuse, so operations on large
+ * texts don't allocate (and lock) their buffers again every time.
+ * Buffers are handed out in power of two sizes and are wiped before
+ * they go back to the pool. Thread-safe.
+ */
+class SecureBufferPool
+{
+public:
+    static SecureBufferPool &instance();
+
+    /**
+     * @param maxPooledBytes_ Released buffers beyond this total are freed.
+     */
+    explicit SecureBufferPool(size_t maxPooledBytes_);
+    ~SecureBufferPool();
+
+    /**
+     * @brief A buffer of at least minSize_ bytes, all zero.
+     */
+    SecureBuffer acquire(size_t minSize_);
+
+    // wipes buffer_ and keeps it for the next acquire()
+    void recycle(SecureBuffer &&buffer_);
+
+private:
+    QMutex m_mutex;
+    std::vector<SecureBuffer> m_buffers;
+    size_t m_pooledBytes = 0;
+    size_t m_maxPooledBytes;
+};
+
+/**
+ * @brief A growable byte array in pooled secure memory, like a minimal
+ * QByteArray for plaintext. The memory goes back to the pool on
+ * destruction.
+ */
+class SecureByteArray
+{
+public:
+    SecureByteArray() = default;
+    explicit SecureByteArray(size_t capacity_);
+    ~SecureByteArray();
+
+    SecureByteArray(const SecureByteArray &) = delete;
+    SecureByteArray &operator=(const SecureByteArray &) = delete;
+
+    const char *constData() const
+    {
+        return m_buffer.data();
+    }
+    char *data()
+    {
+        return m_buffer.data();
+    }
+    size_t size() const
+    {
+        return m_size;
+    }
+    bool isEmpty() const
+    {
+        return m_size == 0;
+    }
+
+    // false if no memory is left
+    bool reserve(size_t capacity_);
+    bool append(const char *data_, size_t size_);
+    // sets the size, bytes added at the end are zero
+    bool resize(size_t size_);
+    // drops the first count_ bytes
+    void remove(size_t count_);
+    // wipes the content, the memory is kept
+    void clear();
+
+private:
+    SecureBuffer m_buffer;
+    size_t m_size = 0;
+};